@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include "ofxBenG.h"
+
+namespace app {
+
+/**
+ * A message from the control threads to the audio thread. Effects are fully constructed
+ * before they are sent, so the audio thread only ever sees finished objects.
+ */
+struct audio_command {
+    enum type {
+        schedule,
+        cancel,
+        sync,
+        selectSample
+    };
+
+    type what;
+    double beat;
+    double tempo;
+    uint64_t micros;
+    ofxBenG::beat_action* effect;
+    uint64_t handle;
+    int index;
+    bool background;
+
+    static audio_command makeSchedule(ofxBenG::beat_action* effect, double beat, uint64_t handle, bool background) {
+        return {schedule, beat, 0, 0, effect, handle, 0, background};
+    }
+
+    static audio_command makeCancel(uint64_t handle) {
+        return {cancel, 0, 0, 0, nullptr, handle, 0, false};
+    }
+
+    static audio_command makeSync(double beat, double tempo, uint64_t micros) {
+        return {sync, beat, tempo, micros, nullptr, 0, 0, false};
+    }
+
+    static audio_command makeSelectSample(int index, double beat) {
+        return {selectSample, beat, 0, 0, nullptr, 0, index, false};
+    }
+};
+
+}
@@ -0,0 +1,405 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include "ofxBenG.h"
+#include "audio_command.h"
+#include "audio_playhead.h"
+#include "beat_clock.h"
+#include "callback_stats.h"
+#include "effect_guard.h"
+#include "effect_heap.h"
+#include "effect_request.h"
+#include "sample_bank.h"
+#include "show_parameters.h"
+#include "smoothed_value.h"
+#include "spsc_queue.h"
+#include "voice_pool.h"
+
+namespace app {
+
+/**
+ * Renders ofxBenG::audio one callback block at a time. The mono mix is pulled into a
+ * preallocated block first and then fanned out to the interleaved output in a separate
+ * loop, so neither loop carries the other's work and the interleave can be vectorized.
+ *
+ * The engine owns scheduled and playing effects on the audio thread. The GL thread never
+ * touches them directly; it send()s commands, which are drained at the top of every block.
+ * The queue is single-producer, so send() must only be called from the GL thread. A sample
+ * selection is swapped in on the sample its beat falls on, like an effect start.
+ *
+ * Playing effects are updated once per block, and a block is split wherever a scheduled
+ * effect is due, so each effect starts on the exact sample its beat falls on rather than on
+ * the next video frame. Effects waiting to start are kept in an effect_heap, so scheduling
+ * and starting cost O(log n) in the effects waiting, and a block only touches the ones due.
+ * schedule() returns a handle that cancel() takes, whether the effect has started or not.
+ *
+ * With an effect_guard set, effects are only updated and started while the guard is held.
+ * A block that finds the GL thread holding it is rendered without touching effects, and
+ * anything due in it starts at the top of the next block; getDeferredBlocks() counts these.
+ *
+ * Effects the engine is done with, whether finished, stolen or dropped, are queued back to
+ * the GL thread and disposed of by reclaim(), so the audio thread never frees memory. An
+ * effect is offered to the recycler first, if one is set, and deleted if it declines. Nor does
+ * it allocate: a playing effect that wants another made, such as an effect_generator, posts
+ * an effect_request, which the GL thread takes with takeRequest() and builds.
+ *
+ * The show's controls reach the audio thread as show_parameters, read once at the top of every
+ * block. The output gain is then smoothed per sample, so sweeping it from an encoder does not
+ * zipper. The tempo and lengths, which playing effects read through getParameters(), are
+ * smoothed a block at a time with the same curve, so a sweep reaches them as a glide too.
+ *
+ * Every render() is timed against the duration of the buffer it fills; see getStats(). Each
+ * also publishes where the audio clock stood at the top of the block; see getPlayhead().
+ */
+class audio_engine {
+public:
+    audio_engine(ofxBenG::audio* audio, sample_bank* bank, int sampleRate, int maxBufferSize, int maxVoices,
+                 smoothed_value::shape smoothing = smoothed_value::linear, float smoothingMillis = 20)
+            : audio(audio), bank(bank), sampleRate(sampleRate), clock(sampleRate), block(maxBufferSize),
+              voices(maxVoices), starts(maxStarts), gain(smoothing, smoothingMillis, sampleRate, 1),
+              tempo(smoothing, smoothingMillis, sampleRate), recordLength(smoothing, smoothingMillis, sampleRate),
+              rewindLength(smoothing, smoothingMillis, sampleRate), stutterLength(smoothing, smoothingMillis, sampleRate) {}
+
+    // Only once the audio stream is closed.
+    ~audio_engine() {
+        audio_command command;
+        while (commands.pop(command)) {
+            if (command.what == audio_command::schedule) {
+                dispose(command.effect);
+            }
+        }
+        auto disposer = [this](ofxBenG::beat_action* effect) { dispose(effect); };
+        starts.clear(disposer);
+        voices.clear(disposer);
+        reclaim();
+    }
+
+    bool send(const audio_command& command) {
+        if (!commands.push(command)) {
+            ofLogWarning("audio_engine") << "command queue full, dropping command " << command.what;
+            return false;
+        }
+        return true;
+    }
+
+    // Returns the handle to cancel the effect with, or 0 if the queue was full and the effect
+    // was disposed of. A background effect, such as an effect_generator, plays outside the
+    // polyphony and is never stolen; see voice_pool.
+    uint64_t schedule(ofxBenG::beat_action* effect, double beat, bool background = false) {
+        uint64_t const handle = nextHandle++;
+        if (!send(audio_command::makeSchedule(effect, beat, handle, background))) {
+            dispose(effect);
+            return 0;
+        }
+        return handle;
+    }
+
+    // Stops the effect if it is playing, or drops it if it has yet to start. Cancelling an
+    // effect that has already finished does nothing.
+    bool cancel(uint64_t handle) {
+        return handle != 0 && send(audio_command::makeCancel(handle));
+    }
+
+    // `micros` is when `beat` was read, so the audio thread can project it to its own time.
+    bool sync(double beat, double tempo, uint64_t micros) {
+        return send(audio_command::makeSync(beat, tempo, micros));
+    }
+
+    // The sample must already be prepared by the bank. A later selection replaces one that
+    // is still waiting for its beat.
+    bool selectSample(int index, double beat = -std::numeric_limits<double>::infinity()) {
+        return send(audio_command::makeSelectSample(index, beat));
+    }
+
+    // GL thread, once per frame.
+    void publishParameters(const show_parameters::values& next) {
+        parameters.publish(next);
+    }
+
+    // Audio thread. The values every sample of the current block works from, with the tempo and
+    // lengths smoothed to where they stand at the end of the block.
+    const show_parameters::values& getParameters() const {
+        return blockParameters;
+    }
+
+    // Audio thread. Applies pending commands, and any selection that is due, without
+    // rendering; render() does this itself.
+    void flush() {
+        drainCommands();
+        if (selection >= 0 && selectionBeat <= clock.getBeat()) {
+            applySelection();
+        }
+    }
+
+    // Audio thread, from a playing effect. Returns false if the queue is full.
+    bool request(const effect_request& requested) {
+        return requests.push(requested);
+    }
+
+    // GL thread.
+    bool takeRequest(effect_request& requested) {
+        return requests.pop(requested);
+    }
+
+    // GL thread.
+    void reclaim() {
+        ofxBenG::beat_action* effect;
+        while (retired.pop(effect)) {
+            dispose(effect);
+        }
+    }
+
+    // GL thread. Returns true if it took the effect back, e.g. into an effect_pool.
+    void setRecycler(std::function<bool(ofxBenG::beat_action*)> recycler) {
+        recycle = recycler;
+    }
+
+    // GL thread, before the audio stream starts.
+    void setGuard(effect_guard* guard) {
+        this->guard = guard;
+    }
+
+    uint64_t getDeferredBlocks() const {
+        return deferredBlocks.load(std::memory_order_relaxed);
+    }
+
+    const voice_pool& getVoices() const {
+        return voices;
+    }
+
+    const callback_stats& getStats() const {
+        return stats;
+    }
+
+    const audio_playhead& getPlayhead() const {
+        return playhead;
+    }
+
+    void render(float* output, int bufferSize, int nChannels) {
+        render(output, bufferSize, nChannels, ofGetElapsedTimeMicros());
+    }
+
+    // `micros` is when the block starts, on the clock sync() times are taken from. Renderers
+    // that run on simulated time pass their own.
+    void render(float* output, int bufferSize, int nChannels, uint64_t micros) {
+        auto const started = std::chrono::steady_clock::now();
+        callbackMicros = micros;
+        renderVoices(output, bufferSize, nChannels);
+        double const renderMicros = std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - started).count();
+        stats.record(renderMicros, bufferSize * 1000000.0 / sampleRate);
+    }
+
+private:
+    static int constexpr maxStarts = 256;
+
+    void renderVoices(float* output, int bufferSize, int nChannels) {
+        flush();
+        // The stream can start before the GL thread first publishes; until it has, there is
+        // nothing to take, and latching the unset zeros would sweep every control up from 0.
+        if (parametersRead || parameters.getPublishedCount() > 0) {
+            smoothParameters(parameters.read(), bufferSize);
+        }
+        gain.setTarget(blockParameters.outputGain);
+
+        audio_playhead::snapshot position;
+        position.frames = framesRendered;
+        position.beat = clock.getBeat();
+        position.beatsPerFrame = clock.getBeatsPerFrame();
+        position.micros = callbackMicros;
+        playhead.publish(position);
+        framesRendered += bufferSize;
+
+        bool const effectsHeld = guard == nullptr || guard->tryLock();
+        if (!effectsHeld) {
+            deferredBlocks.fetch_add(1, std::memory_order_relaxed);
+        }
+        auto retire = [this](ofxBenG::beat_action* effect) { this->retire(effect); };
+        if (effectsHeld) {
+            voices.update(clock.getBeat(), retire);
+            while (!starts.isEmpty() && starts.top().beat <= clock.getBeat()) {
+                uint64_t const handle = starts.top().handle;
+                bool const background = starts.top().background;
+                voices.start(starts.pop(), handle, clock.getBeat(), retire, background);
+            }
+        }
+
+        int const capacity = (int) block.size();
+        int offset = 0;
+        while (offset < bufferSize) {
+            int frames = std::min(capacity, bufferSize - offset);
+            if (selection >= 0) {
+                int const due = clock.framesUntil(selectionBeat);
+                if (due == 0) {
+                    applySelection();
+                    continue;
+                }
+                frames = std::min(frames, due);
+            }
+            if (effectsHeld && !starts.isEmpty()) {
+                int const due = clock.framesUntil(starts.top().beat);
+                if (due == 0) {
+                    double const beat = starts.top().beat;
+                    uint64_t const handle = starts.top().handle;
+                    bool const background = starts.top().background;
+                    voices.start(starts.pop(), handle, beat, retire, background);
+                    continue;
+                }
+                frames = std::min(frames, due);
+            }
+
+            renderBlock(block.data(), frames);
+            interleave(block.data(), output + offset * nChannels, frames, nChannels);
+            clock.advance(frames);
+            offset += frames;
+        }
+        if (guard != nullptr && effectsHeld) {
+            guard->unlock();
+        }
+    }
+
+    void drainCommands() {
+        audio_command command;
+        while (commands.pop(command)) {
+            switch (command.what) {
+                case audio_command::schedule:
+                    pushStart(command.beat, command.handle, command.effect, command.background);
+                    break;
+                case audio_command::cancel:
+                    cancelStart(command.handle);
+                    break;
+                case audio_command::sync:
+                    clock.sync(command.beat, command.tempo, command.micros, callbackMicros);
+                    break;
+                case audio_command::selectSample:
+                    selection = command.index;
+                    selectionBeat = command.beat;
+                    break;
+            }
+        }
+    }
+
+    // The first values published are taken as they are, rather than swept up to from zero.
+    void smoothParameters(const show_parameters::values& published, int frames) {
+        if (!parametersRead) {
+            tempo.reset(published.beatsPerMinute);
+            recordLength.reset(published.recordLengthBeats);
+            rewindLength.reset(published.rewindLengthBeats);
+            stutterLength.reset(published.stutterLengthBeats);
+            parametersRead = true;
+        }
+        blockParameters.beatsPerMinute = follow(tempo, published.beatsPerMinute, frames);
+        blockParameters.recordLengthBeats = follow(recordLength, published.recordLengthBeats, frames);
+        blockParameters.rewindLengthBeats = follow(rewindLength, published.rewindLengthBeats, frames);
+        blockParameters.stutterLengthBeats = follow(stutterLength, published.stutterLengthBeats, frames);
+        blockParameters.outputGain = published.outputGain;
+    }
+
+    static float follow(smoothed_value& smoothed, float target, int frames) {
+        smoothed.setTarget(target);
+        return smoothed.advance(frames);
+    }
+
+    void applySelection() {
+        bank->apply(selection);
+        bank->publish();
+        selection = -1;
+    }
+
+    // If the heap ever fills up, the new effect is dropped rather than growing the heap on the
+    // audio thread.
+    void pushStart(double beat, uint64_t handle, ofxBenG::beat_action* effect, bool background) {
+        if (starts.isFull()) {
+            retire(effect);
+            return;
+        }
+        starts.push(beat, handle, effect, background);
+    }
+
+    void cancelStart(uint64_t handle) {
+        ofxBenG::beat_action* const waiting = starts.remove(handle);
+        if (waiting != nullptr) {
+            retire(waiting);
+            return;
+        }
+        voices.stop(handle, [this](ofxBenG::beat_action* effect) { retire(effect); });
+    }
+
+    // GL thread.
+    void dispose(ofxBenG::beat_action* effect) {
+        if (!recycle || !recycle(effect)) {
+            delete effect;
+        }
+    }
+
+    // If the GL thread falls this far behind, the effect is leaked rather than freed here.
+    void retire(ofxBenG::beat_action* effect) {
+        retired.push(effect);
+    }
+
+    void renderBlock(float* mono, int frames) {
+        for (int i = 0; i < frames; i++) {
+            mono[i] = (float) audio->getMix();
+        }
+        if (gain.isSmoothing()) {
+            for (int i = 0; i < frames; i++) {
+                mono[i] *= gain.next();
+            }
+        } else if (gain.getValue() != 1) {
+            float const level = gain.getValue();
+            for (int i = 0; i < frames; i++) {
+                mono[i] *= level;
+            }
+        }
+    }
+
+    static void interleave(const float* __restrict mono, float* __restrict output, int frames, int nChannels) {
+        if (nChannels == 2) {
+            for (int i = 0; i < frames; i++) {
+                output[2 * i] = mono[i];
+                output[2 * i + 1] = mono[i];
+            }
+            return;
+        }
+
+        for (int i = 0; i < frames; i++) {
+            for (int channel = 0; channel < nChannels; channel++) {
+                output[nChannels * i + channel] = mono[i];
+            }
+        }
+    }
+
+    ofxBenG::audio* audio;
+    sample_bank* bank;
+    int sampleRate;
+    beat_clock clock;
+    std::vector<float> block;
+    voice_pool voices;
+    effect_heap starts;
+    uint64_t nextHandle = 1;
+    int selection = -1;
+    double selectionBeat = 0;
+    std::function<bool(ofxBenG::beat_action*)> recycle;
+    spsc_queue<audio_command, 256> commands;
+    spsc_queue<ofxBenG::beat_action*, 256> retired;
+    spsc_queue<effect_request, 64> requests;
+    callback_stats stats;
+    effect_guard* guard = nullptr;
+    std::atomic<uint64_t> deferredBlocks{0};
+    audio_playhead playhead;
+    show_parameters parameters;
+    show_parameters::values blockParameters;
+    smoothed_value gain;
+    smoothed_value tempo;
+    smoothed_value recordLength;
+    smoothed_value rewindLength;
+    smoothed_value stutterLength;
+    bool parametersRead = false;
+    uint64_t framesRendered = 0;
+    uint64_t callbackMicros = 0;
+};
+
+}
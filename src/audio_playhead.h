@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace app {
+
+/**
+ * Where the audio thread was at its last callback: how many frames it had rendered, the beat
+ * of the first frame of the block, how fast the beat was moving, and when the callback ran.
+ * The audio thread publishes one of these per callback and any other thread can read a
+ * consistent copy without locking, through a sequence counter.
+ */
+class audio_playhead {
+public:
+    struct snapshot {
+        uint64_t frames = 0;
+        double beat = 0;
+        double beatsPerFrame = 0;
+        uint64_t micros = 0;
+    };
+
+    // Audio thread.
+    void publish(const snapshot& next) {
+        uint32_t const sequence = this->sequence.load(std::memory_order_relaxed);
+        this->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        frames.store(next.frames, std::memory_order_relaxed);
+        beat.store(next.beat, std::memory_order_relaxed);
+        beatsPerFrame.store(next.beatsPerFrame, std::memory_order_relaxed);
+        micros.store(next.micros, std::memory_order_relaxed);
+        this->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Any thread. Retries only while a publish is in progress, which takes nanoseconds.
+    snapshot read() const {
+        snapshot copy;
+        uint32_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            copy.frames = frames.load(std::memory_order_relaxed);
+            copy.beat = beat.load(std::memory_order_relaxed);
+            copy.beatsPerFrame = beatsPerFrame.load(std::memory_order_relaxed);
+            copy.micros = micros.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) != 0 || before != after);
+        return copy;
+    }
+
+private:
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint64_t> frames{0};
+    std::atomic<double> beat{0};
+    std::atomic<double> beatsPerFrame{0};
+    std::atomic<uint64_t> micros{0};
+};
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <sstream>
+#include "ofMain.h"
+#include "ofxXmlSettings.h"
+
+namespace app {
+
+/**
+ * Sound device settings, read from audio.xml in the data folder so a show can trade latency
+ * for headroom without a rebuild. Missing or out-of-range values fall back to the defaults
+ * with a warning; a missing file is written out with the defaults so there is something to
+ * edit.
+ */
+struct audio_profile {
+    int sampleRate = 44100;
+    int bufferSize = 512;
+    int bufferCount = 4;
+    int maxVoices = 8;
+    float lookaheadMillis = 250;
+    float smoothingMillis = 20;
+    std::string smoothing = "linear";
+
+    void load(const std::string& path) {
+        ofxXmlSettings xml;
+        if (!xml.load(path)) {
+            ofLogNotice("audio_profile") << "no " << path << ", writing defaults";
+            save(path);
+            return;
+        }
+
+        audio_profile const defaults;
+        sampleRate = xml.getValue("audio:sampleRate", defaults.sampleRate);
+        bufferSize = xml.getValue("audio:bufferSize", defaults.bufferSize);
+        bufferCount = xml.getValue("audio:bufferCount", defaults.bufferCount);
+        maxVoices = xml.getValue("audio:maxVoices", defaults.maxVoices);
+        lookaheadMillis = (float) xml.getValue("audio:lookaheadMillis", defaults.lookaheadMillis);
+        smoothingMillis = (float) xml.getValue("audio:smoothingMillis", defaults.smoothingMillis);
+        smoothing = xml.getValue("audio:smoothing", defaults.smoothing);
+
+        if (sampleRate != 44100 && sampleRate != 48000 && sampleRate != 88200 && sampleRate != 96000) {
+            ofLogWarning("audio_profile") << "unsupported sampleRate " << sampleRate << ", using " << defaults.sampleRate;
+            sampleRate = defaults.sampleRate;
+        }
+        if (bufferSize < 32 || bufferSize > 4096 || (bufferSize & (bufferSize - 1)) != 0) {
+            ofLogWarning("audio_profile") << "bufferSize must be a power of two from 32 to 4096, not " << bufferSize
+                                          << ", using " << defaults.bufferSize;
+            bufferSize = defaults.bufferSize;
+        }
+        if (bufferCount < 1 || bufferCount > 16) {
+            ofLogWarning("audio_profile") << "bufferCount must be 1 to 16, not " << bufferCount
+                                          << ", using " << defaults.bufferCount;
+            bufferCount = defaults.bufferCount;
+        }
+        if (maxVoices < 1 || maxVoices > 64) {
+            ofLogWarning("audio_profile") << "maxVoices must be 1 to 64, not " << maxVoices
+                                          << ", using " << defaults.maxVoices;
+            maxVoices = defaults.maxVoices;
+        }
+        if (lookaheadMillis < 0 || lookaheadMillis > 2000) {
+            ofLogWarning("audio_profile") << "lookaheadMillis must be 0 to 2000, not " << lookaheadMillis
+                                          << ", using " << defaults.lookaheadMillis;
+            lookaheadMillis = defaults.lookaheadMillis;
+        }
+        if (smoothingMillis < 0 || smoothingMillis > 500) {
+            ofLogWarning("audio_profile") << "smoothingMillis must be 0 to 500, not " << smoothingMillis
+                                          << ", using " << defaults.smoothingMillis;
+            smoothingMillis = defaults.smoothingMillis;
+        }
+        if (smoothing != "linear" && smoothing != "exponential") {
+            ofLogWarning("audio_profile") << "smoothing must be linear or exponential, not " << smoothing
+                                          << ", using " << defaults.smoothing;
+            smoothing = defaults.smoothing;
+        }
+    }
+
+    void save(const std::string& path) const {
+        ofxXmlSettings xml;
+        xml.setValue("audio:sampleRate", sampleRate);
+        xml.setValue("audio:bufferSize", bufferSize);
+        xml.setValue("audio:bufferCount", bufferCount);
+        xml.setValue("audio:maxVoices", maxVoices);
+        xml.setValue("audio:lookaheadMillis", lookaheadMillis);
+        xml.setValue("audio:smoothingMillis", smoothingMillis);
+        xml.setValue("audio:smoothing", smoothing);
+        xml.save(path);
+    }
+
+    float getBufferMillis() const {
+        return 1000.0f * bufferSize / sampleRate;
+    }
+
+    // Worst case from a sample being rendered to it leaving the device, ignoring driver overhead.
+    float getOutputLatencyMillis() const {
+        return getBufferMillis() * bufferCount;
+    }
+
+    std::string describe() const {
+        std::ostringstream out;
+        out << sampleRate << " Hz, " << bufferCount << " x " << bufferSize << " frames ("
+            << getBufferMillis() << " ms per buffer, " << getOutputLatencyMillis() << " ms output latency), "
+            << maxVoices << " voices, " << lookaheadMillis << " ms lookahead, "
+            << smoothingMillis << " ms " << smoothing << " smoothing";
+        return out.str();
+    }
+};
+
+}
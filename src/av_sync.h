@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "ofMain.h"
+#include "audio_playhead.h"
+
+namespace app {
+
+/**
+ * Relates the picture to the sound, with the audio clock as the master. The audio playhead
+ * says which beat the audio thread is rendering; the audience hears it one output latency
+ * later. Effects are updated on the audio thread, so whatever they show on screen belongs to
+ * the rendered beat, not the audible one.
+ *
+ * Once per frame, record() takes the beat the shown picture was rendered for and the beat
+ * being heard, and keeps the offset between them in milliseconds. A positive offset means
+ * the picture is ahead of the sound.
+ */
+class av_sync {
+public:
+    av_sync(const audio_playhead& playhead, int sampleRate, float outputLatencyMillis)
+            : playhead(playhead), sampleRate(sampleRate),
+              latencyMicros((int64_t) (outputLatencyMillis * 1000)) {}
+
+    double getRenderedBeat(uint64_t micros) const {
+        auto const position = playhead.read();
+        double const elapsed = (double) ((int64_t) micros - (int64_t) position.micros) / 1000000.0;
+        return position.beat + elapsed * sampleRate * position.beatsPerFrame;
+    }
+
+    double getAudibleBeat(uint64_t micros) const {
+        return getRenderedBeat((uint64_t) ((int64_t) micros - latencyMicros));
+    }
+
+    void record(double shownBeat, double audibleBeat, uint64_t micros) {
+        double const beatsPerMillisecond = sampleRate * playhead.read().beatsPerFrame / 1000.0;
+        if (beatsPerMillisecond <= 0) {
+            return;
+        }
+        offsetMillis = (shownBeat - audibleBeat) / beatsPerMillisecond;
+        meanOffsetMillis = hasRecorded ? meanOffsetMillis + (offsetMillis - meanOffsetMillis) * smoothing : offsetMillis;
+        hasRecorded = true;
+
+        if (micros >= windowEndMicros) {
+            worstLastWindow = worstThisWindow;
+            worstThisWindow = 0;
+            windowEndMicros = micros + windowMicros;
+        }
+        worstThisWindow = std::max(worstThisWindow, std::fabs(offsetMillis));
+    }
+
+    double getOffsetMillis() const {
+        return offsetMillis;
+    }
+
+    double getMeanOffsetMillis() const {
+        return meanOffsetMillis;
+    }
+
+    // The largest offset either way over the last full second.
+    double getWorstOffsetMillis() const {
+        return worstLastWindow;
+    }
+
+private:
+    static double constexpr smoothing = 0.05;
+    static uint64_t constexpr windowMicros = 1000000;
+
+    const audio_playhead& playhead;
+    int sampleRate;
+    int64_t latencyMicros;
+    double offsetMillis = 0;
+    double meanOffsetMillis = 0;
+    bool hasRecorded = false;
+    double worstThisWindow = 0;
+    double worstLastWindow = 0;
+    uint64_t windowEndMicros = 0;
+};
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "ofMain.h"
+
+namespace app {
+
+/**
+ * The beat as the audio thread sees it. It advances by whole blocks at the current tempo and
+ * is pulled toward the Link beat each time the GL thread reports one, so beat positions can
+ * be turned into sample offsets inside a block.
+ */
+class beat_clock {
+public:
+    explicit beat_clock(int sampleRate) : sampleRate(sampleRate) {}
+
+    // Audio thread. `micros` is when the GL thread read `beat` from Link, and `now` is the
+    // time of the block the clock is at.
+    void sync(double beat, double tempo, uint64_t micros, uint64_t now) {
+        double const elapsed = (double) ((int64_t) now - (int64_t) micros) / 1000000.0;
+        double const expected = beat + elapsed * tempo / 60.0;
+        this->tempo = tempo;
+
+        // Small errors are frame jitter and are slewed out so the beat never jumps backwards
+        // inside a bar; anything larger is a Link phase change and is taken as is.
+        double const error = expected - this->beat;
+        if (!synced || std::fabs(error) > resyncBeats) {
+            this->beat = expected;
+            synced = true;
+        } else {
+            this->beat += error * slew;
+        }
+    }
+
+    double getBeat() const {
+        return beat;
+    }
+
+    double getBeatsPerFrame() const {
+        return tempo / 60.0 / sampleRate;
+    }
+
+    // Frames from the current beat until `target`, rounded up so an effect never starts early.
+    int framesUntil(double target) const {
+        double const beatsPerFrame = getBeatsPerFrame();
+        if (beatsPerFrame <= 0) {
+            return target <= beat ? 0 : INT32_MAX;
+        }
+        double const frames = std::ceil((target - beat) / beatsPerFrame);
+        return frames >= INT32_MAX ? INT32_MAX : (int) std::max(frames, 0.0);
+    }
+
+    void advance(int frames) {
+        beat += frames * getBeatsPerFrame();
+    }
+
+private:
+    static double constexpr resyncBeats = 0.25;
+    static double constexpr slew = 0.1;
+
+    int sampleRate;
+    double beat = 0;
+    double tempo = 0;
+    bool synced = false;
+};
+
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include "ofMain.h"
+#include "frame_publisher.h"
+
+namespace app {
+
+/**
+ * Publishes buffer textures to a frame_publisher only when they have changed. Every buffer carries a
+ * generation that markDirty() bumps when its content changes, such as a buffer_watch sees;
+ * publish() skips a buffer whose generation was already sent. A clean buffer is still
+ * republished once every refreshFrames drawn frames, so a change that was never marked shows
+ * up within that many frames rather than never.
+ */
+class buffer_publisher {
+public:
+    buffer_publisher(frame_publisher* output, int bufferCount, int refreshFrames)
+            : output(output), buffers(bufferCount), refreshFrames(refreshFrames) {}
+
+    void markDirty(int buffer) {
+        buffers[buffer].generation++;
+    }
+
+    // Once per drawn frame, before the publish() calls.
+    void beginFrame() {
+        publishedLastFrame = publishedThisFrame;
+        skippedLastFrame = skippedThisFrame;
+        publishedThisFrame = 0;
+        skippedThisFrame = 0;
+        output->beginFrame();
+    }
+
+    void publish(int buffer, ofTexture* texture) {
+        auto& state = buffers[buffer];
+        if (state.generation == state.published && ++state.framesClean < refreshFrames) {
+            skippedThisFrame++;
+            skippedTotal++;
+            return;
+        }
+        output->publishTexture(buffer, texture);
+        state.published = state.generation;
+        state.framesClean = 0;
+        publishedThisFrame++;
+    }
+
+    int getPublishedLastFrame() const {
+        return publishedLastFrame;
+    }
+
+    int getSkippedLastFrame() const {
+        return skippedLastFrame;
+    }
+
+    uint64_t getSkippedTotal() const {
+        return skippedTotal;
+    }
+
+private:
+    struct buffer_state {
+        // Starts ahead of published so every buffer goes out once.
+        uint64_t generation = 1;
+        uint64_t published = 0;
+        int framesClean = 0;
+    };
+
+    frame_publisher* output;
+    std::vector<buffer_state> buffers;
+    int refreshFrames;
+    int publishedThisFrame = 0;
+    int skippedThisFrame = 0;
+    int publishedLastFrame = 0;
+    int skippedLastFrame = 0;
+    uint64_t skippedTotal = 0;
+};
+
+}
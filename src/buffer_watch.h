@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+#include "ofMain.h"
+#include "buffer_publisher.h"
+
+namespace app {
+
+/**
+ * Tells which playmodes buffers changed. ofxBenG gives no word of when a buffer records or a
+ * play head moves, so every buffer is drawn at an eighth of its size into its own tile of a
+ * small FBO, and each tile is compared with the one from the frame before. A recording buffer
+ * changes with every camera frame and a playing effect's buffer with every play head move; a
+ * buffer holding still reads back the same and is left alone.
+ *
+ * The FBO is read back asynchronously into a pixel buffer object, as shm_frame_server does,
+ * and compared on the next frame, so the GL thread never waits on the GPU and a change is
+ * seen one frame late. A change too small to show at an eighth of the size can be missed;
+ * buffer_publisher's periodic republish covers that. GL thread only.
+ */
+class buffer_watch {
+public:
+    buffer_watch(int bufferCount, int width, int height)
+            : bufferCount(bufferCount), tileWidth(width / 8 > 0 ? width / 8 : 1),
+              tileHeight(height / 8 > 0 ? height / 8 : 1) {
+        atlas.allocate(tileWidth * bufferCount, tileHeight, GL_RGBA);
+        rowBytes = (size_t) tileWidth * bufferCount * 4;
+        previous.resize(rowBytes * tileHeight);
+    }
+
+    // Once per frame, after the buffers have been drawn. Marks every buffer whose tile changed
+    // in last frame's readback dirty in `publisher`, then starts this frame's.
+    template<typename Textures>
+    void compare(Textures textureOf, buffer_publisher& publisher) {
+        if (pending) {
+            const unsigned char* pixels = pbo.map<unsigned char>(GL_READ_ONLY);
+            for (int i = 0; i < bufferCount; i++) {
+                if (pixels == nullptr || !compared || tileDiffers(pixels, i)) {
+                    publisher.markDirty(i);
+                }
+            }
+            if (pixels != nullptr) {
+                std::memcpy(previous.data(), pixels, previous.size());
+                compared = true;
+            }
+            pbo.unmap();
+            pending = false;
+        }
+
+        atlas.begin();
+        ofClear(0, 255);
+        for (int i = 0; i < bufferCount; i++) {
+            textureOf(i).draw(i * tileWidth, 0, tileWidth, tileHeight);
+        }
+        atlas.end();
+        if (!pbo.isAllocated()) {
+            pbo.allocate(previous.size(), GL_STREAM_READ);
+        }
+        atlas.getTexture().copyTo(pbo);
+        pending = true;
+    }
+
+private:
+    bool tileDiffers(const unsigned char* pixels, int tile) const {
+        size_t const tileBytes = (size_t) tileWidth * 4;
+        for (int row = 0; row < tileHeight; row++) {
+            size_t const start = row * rowBytes + tile * tileBytes;
+            if (std::memcmp(pixels + start, previous.data() + start, tileBytes) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int bufferCount;
+    int tileWidth;
+    int tileHeight;
+    size_t rowBytes;
+    ofFbo atlas;
+    ofBufferObject pbo;
+    std::vector<unsigned char> previous;
+    bool pending = false;
+    bool compared = false;
+};
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace app {
+
+/**
+ * How long each audio callback took against its deadline, the time the buffer covers. The
+ * audio thread records into a fixed histogram with relaxed atomics, so recording never
+ * blocks or allocates; the GL thread reads percentiles from it whenever it likes.
+ *
+ * A near miss is a callback that used more than nearMissFraction of its deadline. An xrun is
+ * one that overran it, which means the device ran out of samples.
+ */
+class callback_stats {
+public:
+    static int constexpr bucketMicros = 5;
+    static int constexpr bucketCount = 4096;
+    static double constexpr nearMissFraction = 0.8;
+
+    callback_stats() {
+        for (auto& bucket : buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Audio thread.
+    void record(double renderMicros, double deadlineMicros) {
+        int const bucket = renderMicros < bucketCount * bucketMicros ? (int) (renderMicros / bucketMicros) : bucketCount;
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        callbacks.fetch_add(1, std::memory_order_relaxed);
+        if (renderMicros > deadlineMicros) {
+            xruns.fetch_add(1, std::memory_order_relaxed);
+        } else if (renderMicros > deadlineMicros * nearMissFraction) {
+            nearMisses.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (renderMicros > maxMicros.load(std::memory_order_relaxed)) {
+            maxMicros.store(renderMicros, std::memory_order_relaxed);
+        }
+        this->deadlineMicros.store(deadlineMicros, std::memory_order_relaxed);
+    }
+
+    uint64_t getCallbacks() const {
+        return callbacks.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getNearMisses() const {
+        return nearMisses.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getXruns() const {
+        return xruns.load(std::memory_order_relaxed);
+    }
+
+    double getMaxMicros() const {
+        return maxMicros.load(std::memory_order_relaxed);
+    }
+
+    double getDeadlineMicros() const {
+        return deadlineMicros.load(std::memory_order_relaxed);
+    }
+
+    // The upper edge of the bucket holding the given fraction of callbacks, e.g. 0.99.
+    double getPercentileMicros(double fraction) const {
+        uint64_t total = 0;
+        for (auto& bucket : buckets) {
+            total += bucket.load(std::memory_order_relaxed);
+        }
+        if (total == 0) {
+            return 0;
+        }
+
+        uint64_t const target = (uint64_t) (fraction * total);
+        uint64_t seen = 0;
+        for (int i = 0; i <= bucketCount; i++) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen > target) {
+                return i == bucketCount ? getMaxMicros() : (double) (i + 1) * bucketMicros;
+            }
+        }
+        return getMaxMicros();
+    }
+
+    bool dump(const std::string& path) const {
+        std::ofstream file(path, std::ios::trunc);
+        file << "callbacks " << getCallbacks() << "\n"
+             << "deadlineMicros " << getDeadlineMicros() << "\n"
+             << "p50Micros " << getPercentileMicros(0.5) << "\n"
+             << "p99Micros " << getPercentileMicros(0.99) << "\n"
+             << "maxMicros " << getMaxMicros() << "\n"
+             << "nearMisses " << getNearMisses() << "\n"
+             << "xruns " << getXruns() << "\n"
+             << "# bucketStartMicros count\n";
+        for (int i = 0; i <= bucketCount; i++) {
+            uint32_t const count = buckets[i].load(std::memory_order_relaxed);
+            if (count > 0) {
+                file << i * bucketMicros << " " << count << "\n";
+            }
+        }
+        return (bool) file;
+    }
+
+private:
+    // The last bucket collects everything slower than the histogram covers.
+    std::array<std::atomic<uint32_t>, bucketCount + 1> buckets;
+    std::atomic<uint64_t> callbacks{0};
+    std::atomic<uint64_t> nearMisses{0};
+    std::atomic<uint64_t> xruns{0};
+    std::atomic<double> maxMicros{0};
+    std::atomic<double> deadlineMicros{0};
+};
+
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "ofMain.h"
+#include "ofxBenG.h"
+#include "audio_engine.h"
+#include "clock_snapshot.h"
+#include "sample_bank.h"
+#include "simulated_clock.h"
+
+namespace app {
+
+/**
+ * Runs the audio engine against a simulated_clock on simulated time, with no window, sound
+ * device or network, and reports how closely the engine's beat follows the clock through the
+ * script's tempo changes and phase jumps. The same script gives the same numbers every run.
+ *
+ * Frames are updated at 60 Hz and audio blocks rendered at the block rate, interleaved in
+ * time order as they would be live. Each frame syncs the engine from a clock_snapshot, as
+ * ofApp does, and every 37 frames, so at every phase of the beat, a probe effect is scheduled
+ * on the next whole beat, as a key press would.
+ *
+ * At the top of every block the engine's beat is compared with the clock's true beat; the
+ * difference, in milliseconds at the current tempo, is how early or late an effect due then
+ * would start. A probe that starts after its beat is counted as late; that happens when it
+ * reaches the audio thread after its beat, such as a key pressed within a block of the beat.
+ */
+class clock_bench {
+public:
+    static int run(const std::string& scriptPath, double seconds) {
+        simulated_clock::script timeline;
+        if (!timeline.parse(scriptPath)) {
+            return 1;
+        }
+
+        int const sampleRate = 44100;
+        int const bufferSize = 512;
+        int const nChannels = 2;
+        uint64_t const frameMicros = 1000000 / 60;
+        double const settledMillis = 1.0;
+        simulated_clock clock(timeline, true);
+        ofxBenG::audio audio(sampleRate, nChannels, bufferSize);
+        sample_bank bank;
+        audio_engine engine(&audio, &bank, sampleRate, bufferSize, maxVoices);
+        std::vector<float> block(bufferSize * nChannels);
+
+        probe_results probes;
+        std::vector<double> errors;
+        uint64_t const endMicros = (uint64_t) (seconds * 1000000.0);
+        uint64_t nextFrame = 0;
+        long blocks = 0;
+        int frames = 0;
+        size_t eventsSeen = 0;
+        double worstSinceEvent = 0;
+        uint64_t lastEventMicros = 0;
+        uint64_t settledMicros = 0;
+        uint64_t worstSettleMicros = 0;
+        while (true) {
+            uint64_t const nextBlock = (uint64_t) (blocks * bufferSize * 1000000.0 / sampleRate);
+            if (nextBlock >= endMicros && nextFrame >= endMicros) {
+                break;
+            }
+
+            if (nextFrame <= nextBlock) {
+                clock.setTime(nextFrame);
+                clock_snapshot const snapshot = clock_snapshot::capture(clock, 0, nextFrame);
+                if (frames % 37 == 0) {
+                    double const beat = snapshot.getNextWholeBeat();
+                    engine.schedule(new probe(beat, &probes), beat);
+                    probes.scheduled++;
+                }
+                engine.sync(snapshot.beat, snapshot.tempo, snapshot.micros);
+                engine.reclaim();
+                frames++;
+                nextFrame += frameMicros;
+                continue;
+            }
+
+            clock.setTime(nextBlock);
+            double const trueBeat = clock.getTrueBeat();
+            double const tempo = clock.getTempo();
+            engine.render(block.data(), bufferSize, nChannels, nextBlock);
+            blocks++;
+            if (blocks == 1) {
+                continue;
+            }
+
+            // The block just rendered started from the beat the engine held at nextBlock.
+            double const engineBeat = engine.getPlayhead().read().beat;
+            double const errorMillis = (engineBeat - trueBeat) * 60000.0 / tempo;
+            errors.push_back(std::fabs(errorMillis));
+
+            if (clock.getEventsReached() != eventsSeen) {
+                eventsSeen = clock.getEventsReached();
+                lastEventMicros = nextBlock;
+                settledMicros = 0;
+                worstSinceEvent = 0;
+            }
+            if (eventsSeen > 0) {
+                worstSinceEvent = std::max(worstSinceEvent, std::fabs(errorMillis));
+                if (std::fabs(errorMillis) > settledMillis) {
+                    settledMicros = 0;
+                } else if (settledMicros == 0) {
+                    settledMicros = nextBlock;
+                    worstSettleMicros = std::max(worstSettleMicros, settledMicros - lastEventMicros);
+                }
+            }
+        }
+        engine.reclaim();
+
+        if (errors.empty()) {
+            ofLogError("clock_bench") << "nothing was rendered";
+            return 1;
+        }
+        std::sort(errors.begin(), errors.end());
+        double mean = 0;
+        for (double error : errors) {
+            mean += error;
+        }
+        mean /= errors.size();
+        ofLogNotice("clock_bench") << "simulated " << seconds << " s, " << frames << " frames, " << blocks
+                                   << " blocks, " << eventsSeen << " script events";
+        ofLogNotice("clock_bench") << "engine beat error mean " << mean << " ms, p99 "
+                                   << errors[(size_t) (errors.size() * 0.99)] << " ms, worst " << errors.back() << " ms";
+        if (eventsSeen > 0) {
+            ofLogNotice("clock_bench") << "worst time to settle within " << settledMillis << " ms after a script event "
+                                       << worstSettleMicros / 1000.0 << " ms";
+        }
+        ofLogNotice("clock_bench") << probes.scheduled << " probes scheduled, " << probes.started << " started, "
+                                   << probes.late << " late by up to " << probes.worstLateBeats * 60000.0 / timeline.bpm
+                                   << " ms at the starting tempo";
+        return 0;
+    }
+
+private:
+    static int constexpr maxVoices = 8;
+
+    struct probe_results {
+        int scheduled = 0;
+        int started = 0;
+        int late = 0;
+        double worstLateBeats = 0;
+    };
+
+    // Records the beat it was started on, then finishes.
+    class probe : public ofxBenG::beat_action {
+    public:
+        probe(double beat, probe_results* results) : beat(beat), results(results) {}
+
+        void update(float now) override {
+            if (started) {
+                return;
+            }
+            started = true;
+            results->started++;
+            // The engine starts an effect on its beat, or on the engine's beat if that is later.
+            double const lateBeats = now - (float) beat;
+            if (lateBeats > 0) {
+                results->late++;
+                results->worstLateBeats = std::max(results->worstLateBeats, lateBeats);
+            }
+        }
+
+        bool isDone(float) override {
+            return started;
+        }
+
+    private:
+        double beat;
+        probe_results* results;
+        bool started = false;
+    };
+};
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include "ofMain.h"
+#include "clock_source.h"
+
+namespace app {
+
+/**
+ * The Link session, or the clock_source standing in for it, as it stood at one moment: the
+ * beat, the tempo, the phase within the quantum, and when it was read. Every Link query
+ * captures the session afresh, so reading it once per frame and handing the copy around
+ * keeps the timeline, the HUD and new effects on the same beat for the whole frame.
+ *
+ * Anything that happens later in the frame, such as a key press, projects the snapshot to
+ * its own time at the snapshot's tempo rather than asking Link again.
+ */
+struct clock_snapshot {
+    double beat = 0;
+    double tempo = 0;
+    double phase = 0;
+    double quantum = 0;
+    uint64_t micros = 0;
+
+    static clock_snapshot capture(clock_source& source, double quantum, uint64_t micros = ofGetElapsedTimeMicros()) {
+        clock_snapshot captured;
+        captured.beat = source.getBeat();
+        captured.tempo = source.getTempo();
+        captured.micros = micros;
+        captured.quantum = quantum;
+        captured.phase = quantum > 0 ? captured.beat - std::floor(captured.beat / quantum) * quantum : 0;
+        return captured;
+    }
+
+    // The beat at `at`, assuming the tempo holds.
+    double getBeatAt(uint64_t at) const {
+        return beat + (double) ((int64_t) at - (int64_t) micros) / 1000000.0 * tempo / 60.0;
+    }
+
+    // The first whole beat after the beat at `at`.
+    double getNextWholeBeat(uint64_t at) const {
+        return std::floor(getBeatAt(at)) + 1;
+    }
+
+    double getNextWholeBeat() const {
+        return getNextWholeBeat(micros);
+    }
+};
+
+}
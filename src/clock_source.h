@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ofxBenG.h"
+
+namespace app {
+
+/**
+ * Where the app gets its beat and tempo from. Live, that is an Ableton Link session; for
+ * tests and benchmarks it can be a simulated_clock running entirely in-process. Control
+ * thread only.
+ */
+class clock_source {
+public:
+    virtual ~clock_source() {}
+    virtual double getBeat() = 0;
+    virtual double getTempo() = 0;
+    virtual void setTempo(double beatsPerMinute) = 0;
+};
+
+class link_clock : public clock_source {
+public:
+    link_clock(float beatsPerMinute, float quantum) {
+        link.setupLink(beatsPerMinute, quantum);
+    }
+
+    double getBeat() override {
+        return link.getBeat();
+    }
+
+    double getTempo() override {
+        return link.getTempo();
+    }
+
+    void setTempo(double beatsPerMinute) override {
+        link.setBeatsPerMinute((int) beatsPerMinute);
+    }
+
+private:
+    ofxBenG::ableton link;
+};
+
+}
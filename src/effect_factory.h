@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include "ofMain.h"
+#include "ofxBenG.h"
+#include "effect_request.h"
+#include "sample_bank.h"
+
+namespace app {
+
+/**
+ * Makes the stutters and rewinds for a show, live or offline, so that each is determined by
+ * its kind, beat, tempo and seed alone. ofxBenG's factories draw their lengths and offsets
+ * from ofRandom, so ofRandom is seeded with the effect's own seed right before each one is
+ * made. The seeds come from a generator per kind, and one for effect generators, all derived
+ * from the show's seed, so a show's effects can be replayed from its log.
+ *
+ * GL thread only; nothing else may draw from ofRandom.
+ */
+class effect_factory {
+public:
+    effect_factory(ofxBenG::playmodes* playModes, sample_bank* bank, ofxBenG::audio* audio, uint32_t showSeed)
+            : playModes(playModes), bank(bank), audio(audio),
+              stutterSeeds(showSeed), rewindSeeds(showSeed ^ 0x9e3779b9u), generatorSeeds(showSeed ^ 0x7f4a7c15u) {}
+
+    // Draws the effect's seed from its kind's generator and returns it in `seed`.
+    ofxBenG::beat_action* make(effect_request::type what, double beat, float beatsPerMinute, uint32_t& seed) {
+        seed = (uint32_t) (what == effect_request::stutter ? stutterSeeds() : rewindSeeds());
+        return remake(what, beat, beatsPerMinute, seed);
+    }
+
+    // The same effect make() returned with this seed.
+    ofxBenG::beat_action* remake(effect_request::type what, double beat, float beatsPerMinute, uint32_t seed) {
+        ofSeedRandom((int) seed);
+        if (what == effect_request::stutter) {
+            return ofxBenG::stutter::make_random(beat, beatsPerMinute, playModes, bank->getForwards(), audio);
+        }
+        return ofxBenG::rewind::make_random(beat, beatsPerMinute, playModes, bank->getForwards(),
+                bank->getBackwards(), audio);
+    }
+
+    // For an effect_generator, which draws its effects' seeds from a generator of its own.
+    uint32_t makeGeneratorSeed() {
+        return (uint32_t) generatorSeeds();
+    }
+
+private:
+    ofxBenG::playmodes* playModes;
+    sample_bank* bank;
+    ofxBenG::audio* audio;
+    std::mt19937 stutterSeeds;
+    std::mt19937 rewindSeeds;
+    std::mt19937 generatorSeeds;
+};
+
+}
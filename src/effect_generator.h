@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include "ofxBenG.h"
+#include "audio_engine.h"
+#include "effect_request.h"
+
+namespace app {
+
+/**
+ * Plays an endless run of random stutters and rewinds until it is cancelled. The first comes
+ * one record length after the generator starts, and each after that follows the last by the
+ * record length plus the last effect's own length. It replaces
+ * ofxBenG::effect_generator, which made its effects and fired its event from update(), so it
+ * allocated and locked on the audio thread.
+ *
+ * This one is updated on the audio thread too, but only draws the next effect from its own
+ * generator and posts an effect_request through the engine about a beat ahead of it; the GL
+ * thread makes and schedules the effect on the requested beat. Lengths and tempo come from
+ * the engine's parameters for the block. If the request queue is full the effect is asked for
+ * again on the next block, and is late only if the GL thread is a beat behind.
+ */
+class effect_generator : public ofxBenG::beat_action {
+public:
+    // `id` comes back in every request, so requests from a cancelled generator can be dropped.
+    effect_generator(audio_engine* engine, uint32_t seed, uint64_t id)
+            : engine(engine), random(seed), id(id) {
+        draw();
+    }
+
+    void update(float beat) override {
+        float const leadBeats = 1;
+        auto& parameters = engine->getParameters();
+        float const minimumStepBeats = 0.25f;
+        if (!started) {
+            nextBeat = beat + std::max(parameters.recordLengthBeats, minimumStepBeats);
+            started = true;
+        }
+        while (beat >= nextBeat - leadBeats) {
+            effect_request const requested = {nextKind, nextBeat, parameters.beatsPerMinute, nextSeed, id, count};
+            if (!engine->request(requested)) {
+                return;
+            }
+            float const lengthBeats = nextKind == effect_request::stutter
+                    ? parameters.stutterLengthBeats : parameters.rewindLengthBeats;
+            nextBeat += std::max(parameters.recordLengthBeats + lengthBeats, minimumStepBeats);
+            count++;
+            draw();
+        }
+    }
+
+    bool isDone(float) override {
+        return false;
+    }
+
+private:
+    void draw() {
+        nextKind = random() % 2 == 0 ? effect_request::stutter : effect_request::rewind;
+        nextSeed = (uint32_t) random();
+    }
+
+    audio_engine* engine;
+    std::mt19937 random;
+    uint64_t id;
+    double nextBeat = 0;
+    bool started = false;
+    effect_request::type nextKind;
+    uint32_t nextSeed;
+    int count = 0;
+};
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+namespace app {
+
+/**
+ * Keeps the GL thread and the playing effects out of the playmodes buffers at the same time.
+ * The stutter and rewind effects move play heads in those buffers from update(), which the
+ * audio engine calls on the audio thread, while the GL thread grabs into and draws from the
+ * same buffers; ofxBenG does no locking of its own.
+ *
+ * The audio thread never waits: if the GL thread holds the guard, the engine renders the
+ * block without updating or starting effects, and they catch up on the next block. The GL
+ * thread waits out an audio block that holds it, which takes well under a millisecond, so
+ * it should hold the guard only around its own playmodes calls.
+ */
+class effect_guard {
+public:
+    // GL thread.
+    void lock() {
+        while (held.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Audio thread.
+    bool tryLock() {
+        return !held.test_and_set(std::memory_order_acquire);
+    }
+
+    void unlock() {
+        held.clear(std::memory_order_release);
+    }
+
+private:
+    std::atomic_flag held = ATOMIC_FLAG_INIT;
+};
+
+}
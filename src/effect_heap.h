@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "ofxBenG.h"
+
+namespace app {
+
+/**
+ * Scheduled effects waiting for their start beat, as a binary min-heap on the beat. All
+ * storage is allocated up front, so pushing and popping on the audio thread never allocate,
+ * and both cost O(log n) however many effects are waiting. Effects due on the same beat
+ * come out in the order they were pushed.
+ *
+ * Each effect carries the handle it was scheduled with, so it can be cancelled before it
+ * starts, and whether it is to start as a background voice (see voice_pool).
+ */
+class effect_heap {
+public:
+    struct entry {
+        double beat;
+        uint64_t order;
+        uint64_t handle;
+        ofxBenG::beat_action* effect;
+        bool background;
+    };
+
+    explicit effect_heap(int capacity) : entries((size_t) capacity) {}
+
+    bool isEmpty() const {
+        return count == 0;
+    }
+
+    bool isFull() const {
+        return count == (int) entries.size();
+    }
+
+    int size() const {
+        return count;
+    }
+
+    // The earliest effect; only when not empty.
+    const entry& top() const {
+        return entries[0];
+    }
+
+    // Only when not full.
+    void push(double beat, uint64_t handle, ofxBenG::beat_action* effect, bool background = false) {
+        entries[count] = {beat, nextOrder++, handle, effect, background};
+        std::push_heap(entries.begin(), entries.begin() + ++count, later);
+    }
+
+    ofxBenG::beat_action* pop() {
+        std::pop_heap(entries.begin(), entries.begin() + count--, later);
+        return entries[count].effect;
+    }
+
+    // Takes the effect with this handle out of the heap, or returns nullptr if none is waiting.
+    // Finding it is a linear scan, but cancelling is rare and the heap is small.
+    ofxBenG::beat_action* remove(uint64_t handle) {
+        for (int i = 0; i < count; i++) {
+            if (entries[i].handle != handle) {
+                continue;
+            }
+            ofxBenG::beat_action* const removed = entries[i].effect;
+            entries[i] = entries[--count];
+            std::make_heap(entries.begin(), entries.begin() + count, later);
+            return removed;
+        }
+        return nullptr;
+    }
+
+    // Hands every effect back, e.g. on shutdown once the audio thread has stopped.
+    template<typename Retire>
+    void clear(Retire retire) {
+        for (int i = 0; i < count; i++) {
+            retire(entries[i].effect);
+        }
+        count = 0;
+    }
+
+private:
+    static bool later(const entry& a, const entry& b) {
+        return a.beat > b.beat || (a.beat == b.beat && a.order > b.order);
+    }
+
+    std::vector<entry> entries;
+    int count = 0;
+    uint64_t nextOrder = 0;
+};
+
+}
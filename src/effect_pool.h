@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ofxBenG.h"
+
+namespace app {
+
+/**
+ * Fixed storage for effects of one type, so effects made and freed over a long show reuse
+ * the same slots instead of churning the allocator. GL thread only: effects are made when
+ * they are scheduled and released when the audio engine reclaims them.
+ *
+ * Only effects built in this tree can be pooled; stutters and rewinds are allocated inside
+ * ofxBenG by make_random and are still deleted as before.
+ *
+ * If every slot is taken, make() falls back to the heap and counts it. release() takes any
+ * effect and returns false for one the pool does not own, so it can sit in front of a plain
+ * delete.
+ */
+template<typename T>
+class effect_pool {
+public:
+    explicit effect_pool(int capacity) : slots((size_t) capacity), taken((size_t) capacity, false) {
+        for (int i = capacity - 1; i >= 0; i--) {
+            freeSlots.push_back(i);
+        }
+    }
+
+    ~effect_pool() {
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (taken[i]) {
+                get(i)->~T();
+            }
+        }
+    }
+
+    template<typename... Args>
+    T* make(Args&&... args) {
+        if (freeSlots.empty()) {
+            overflowCount++;
+            return new T(std::forward<Args>(args)...);
+        }
+        int const slot = freeSlots.back();
+        freeSlots.pop_back();
+        taken[slot] = true;
+        return new (&slots[slot]) T(std::forward<Args>(args)...);
+    }
+
+    bool release(ofxBenG::beat_action* effect) {
+        auto const address = reinterpret_cast<uintptr_t>(effect);
+        auto const first = reinterpret_cast<uintptr_t>(slots.data());
+        if (address < first || address >= first + slots.size() * sizeof(storage)) {
+            return false;
+        }
+        int const slot = (int) ((address - first) / sizeof(storage));
+        get(slot)->~T();
+        taken[slot] = false;
+        freeSlots.push_back(slot);
+        return true;
+    }
+
+    int getLiveCount() const {
+        return (int) (slots.size() - freeSlots.size());
+    }
+
+    uint64_t getOverflowCount() const {
+        return overflowCount;
+    }
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+    T* get(size_t slot) {
+        return reinterpret_cast<T*>(&slots[slot]);
+    }
+
+    std::vector<storage> slots;
+    std::vector<bool> taken;
+    std::vector<int> freeSlots;
+    uint64_t overflowCount = 0;
+};
+
+}
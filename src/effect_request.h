@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+namespace app {
+
+/**
+ * A message from an effect playing on the audio thread to the GL thread, asking for another
+ * effect to be made. Effects allocate and touch playmodes when they are made, which the audio
+ * thread must not do, so a generator only says what it wants and the GL thread builds it.
+ */
+struct effect_request {
+    enum type {
+        stutter,
+        rewind
+    };
+
+    type what;
+    double beat;
+    float beatsPerMinute;
+    uint32_t seed;
+    uint64_t generator;
+    int count;
+};
+
+}
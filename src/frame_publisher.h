@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxBenG.h"
+
+namespace app {
+
+/**
+ * Somewhere buffer textures go for other local processes to pick up: Syphon on macOS, a
+ * shared-memory ring elsewhere. beginFrame() is called once per drawn frame before any
+ * publishTexture() calls, whether or not anything is published that frame.
+ */
+class frame_publisher {
+public:
+    virtual ~frame_publisher() {}
+    virtual void beginFrame() {}
+    virtual void publishTexture(int buffer, ofTexture* texture) = 0;
+};
+
+#ifdef TARGET_OSX
+class syphon_frame_publisher : public frame_publisher {
+public:
+    explicit syphon_frame_publisher(int bufferCount) : syphon(bufferCount) {}
+
+    void publishTexture(int buffer, ofTexture* texture) override {
+        syphon.publishTexture(buffer, texture);
+    }
+
+private:
+    ofxBenG::syphon syphon;
+};
+#endif
+
+}
@@ -1,13 +1,33 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "clock_bench.h"
+#include "offline_renderer.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char* argv[]){
+	// Stutter --render <script> <output.wav> renders a scripted show without a window or sound device
+	if (argc == 4 && std::string(argv[1]) == "--render") {
+		return app::offline_renderer::run(argv[2], argv[3]);
+	}
+
+	// Stutter --replay <show.log> <output.wav> renders a show the app logged while it was played
+	if (argc == 4 && std::string(argv[1]) == "--replay") {
+		return app::offline_renderer::replay(argv[2], argv[3]);
+	}
+
+	// Stutter --bench-clock <script> [seconds] measures how the audio engine follows a simulated clock
+	if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--bench-clock") {
+		return app::clock_bench::run(argv[2], argc == 4 ? std::atof(argv[3]) : 120);
+	}
+
+	// Stutter --clock <script> runs the show on a simulated clock instead of Ableton Link
+	std::string const clockScript = argc == 3 && std::string(argv[1]) == "--clock" ? argv[2] : "";
+
 	ofSetupOpenGL(1024,768,OF_WINDOW);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
 	// can be OF_WINDOW or OF_FULLSCREEN
 	// pass in width and height too:
-	ofRunApp(new ofApp());
+	ofRunApp(new ofApp(clockScript));
 
 }
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <algorithm>
+#include "ofxMaxim.h"
+
+namespace app {
+
+/**
+ * Exchanges the decoded PCM of two samples without copying or allocating. Playback position
+ * stays with the object, so anything holding a pointer to either sample keeps working and
+ * simply plays the new data from where it was.
+ */
+inline void swapStorage(ofxMaxiSample& a, ofxMaxiSample& b) {
+    std::swap(a.myData, b.myData);
+    std::swap(a.temp, b.temp);
+    std::swap(a.myDataSize, b.myDataSize);
+    std::swap(a.length, b.length);
+    std::swap(a.myChannels, b.myChannels);
+    std::swap(a.mySampleRate, b.mySampleRate);
+}
+
+/**
+ * Fills `reversed` with `forwards` played back to front. ofxMaxiSample plays from its
+ * decoded frames, so the result interpolates exactly as well as the forward sample does.
+ * A sample that never decoded leaves `reversed` as it was and returns false.
+ */
+inline bool reverseInto(const ofxMaxiSample& forwards, ofxMaxiSample& reversed) {
+    if (forwards.temp == nullptr || forwards.length <= 0) {
+        return false;
+    }
+    reversed = forwards;
+    std::reverse(reversed.temp, reversed.temp + reversed.length);
+    return true;
+}
+
+}
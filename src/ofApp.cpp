@@ -1,96 +1,220 @@
 #include "ofApp.h"
+#include <random>
 
 void ofApp::setup() {
-    sampleRate = 44100;
-    audioBufferSize = 512;
+    audioProfile.load(ofToDataPath("audio.xml"));
+    ofLogNotice("ofApp") << "audio: " << audioProfile.describe();
+    sampleRate = audioProfile.sampleRate;
+    audioBufferSize = audioProfile.bufferSize;
     audio = new ofxBenG::audio(sampleRate, 2, audioBufferSize);
-    ofSoundStreamSetup(2, 0, this, sampleRate, audioBufferSize, 4);
-    samples.push_back({"silence.wav", "silence.wav"});
-    samples.push_back({"fancyfort-forwards.wav", "fancyfort-backwards.wav"});
-    samples.push_back({"dreamstonite-forwards.wav", "dreamstonite-backwards.wav"});
-    samples.push_back({"arrows-forwards.wav", "arrows-backwards.wav"});
+    sampleBank = new app::sample_bank();
+    sampleBank->add("silence.wav");
+    sampleBank->add("fancyfort-forwards.wav");
+    sampleBank->add("dreamstonite-forwards.wav");
+    sampleBank->add("arrows-forwards.wav");
+    sampleBank->preload();
+    auto const smoothing = audioProfile.smoothing == "exponential" ? app::smoothed_value::exponential : app::smoothed_value::linear;
+    engine = new app::audio_engine(audio, sampleBank, sampleRate, audioBufferSize, audioProfile.maxVoices,
+            smoothing, audioProfile.smoothingMillis);
+    engine->setGuard(&effectGuard);
+    engine->setRecycler([this](ofxBenG::beat_action* effect) { return generatorPool.release(effect); });
+    samplePreroll = new app::sample_preroll(sampleBank, engine, audioProfile.lookaheadMillis);
+
+    // Every effect's seed is drawn from the show's; logging it lets the show be replayed.
+    app::show_log::header logged;
+    logged.seed = std::random_device()();
+    logged.sampleRate = sampleRate;
+    logged.bufferSize = audioBufferSize;
+    for (int i = 0; i < sampleBank->size(); i++) {
+        logged.samples.push_back(sampleBank->getPath(i));
+    }
+    std::string const logPath = ofToDataPath("show-" + ofGetTimestampString() + ".log");
+    if (!showLog.open(logPath, logged)) {
+        ofLogWarning("ofApp") << "cannot write " << logPath;
+    }
+    ofSoundStreamSetup(2, 0, this, sampleRate, audioBufferSize, audioProfile.bufferCount);
     loadSample(0);
-
-    ableton = new ofxBenG::ableton();
-    ableton->setupLink(beatsPerMinute, 8.0);
+    float const latencyMillis = audioProfile.getOutputLatencyMillis();
+    avSync = new app::av_sync(engine->getPlayhead(), sampleRate, latencyMillis);
+
+    // A clock script that cannot be read falls back to Link, so the show still runs.
+    simulatedClock = !clockScriptPath.empty() && clockScript.parse(clockScriptPath);
+    if (simulatedClock) {
+        ofLogNotice("ofApp") << "clock: simulated from " << clockScriptPath;
+        clockSource = new app::simulated_clock(clockScript);
+    } else {
+        clockSource = new app::link_clock(beatsPerMinute, linkQuantum);
+    }
 
     const float desiredWidth = ofApp::width;
     const float desiredHeight = ofApp::height;
-    playModes = new ofxBenG::playmodes(ofxBenG::playmodes::c920, desiredWidth, desiredHeight, 60);
+    playModes = new ofxBenG::playmodes(ofxBenG::playmodes::c920, desiredWidth, desiredHeight, cameraFramesPerSecond);
     ofSetWindowShape(playModes->getWidth(), playModes->getHeight());
-
-    syphon = new ofxBenG::syphon(playModes->getBufferCount());
-
-    beatsPerMinute.addSubscriber([&]() { ableton->setBeatsPerMinute((int)beatsPerMinute); });
+    effects = new app::effect_factory(playModes, sampleBank, audio, logged.seed);
+
+#ifdef TARGET_OSX
+    frameOutput = new app::syphon_frame_publisher(playModes->getBufferCount());
+#else
+    frameOutput = new app::shm_frame_server("/stutter-frames", playModes->getBufferCount(),
+            playModes->getWidth(), playModes->getHeight());
+#endif
+    publisher = new app::buffer_publisher(frameOutput, playModes->getBufferCount(), bufferRefreshFrames);
+    bufferTextures.resize(playModes->getBufferCount());
+    bufferWatch = new app::buffer_watch(playModes->getBufferCount(), playModes->getWidth(), playModes->getHeight());
+
+    // Enough frames to cover the output latency at up to 120 Hz, plus one drawn late.
+    videoDelay = new app::video_delay(playModes->getWidth(), playModes->getHeight(),
+            (int) std::ceil(latencyMillis * 120 / 1000) + 2);
+
+    // A simulated clock plays its script's tempo alone, so the same script runs the same way
+    // whatever the encoder is set to.
+    if (!simulatedClock) {
+        beatsPerMinute.addSubscriber([&]() { clockSource->setTempo(beatsPerMinute); });
+    }
     propertyBag.add(δ(beatsPerMinute));
     propertyBag.add(δ(recordLengthBeats));
     propertyBag.add(δ(rewindLengthBeats));
     propertyBag.add(δ(stutterLengthBeats));
+    propertyBag.add(δ(outputGain));
     propertyBag.loadFromXml();
+    clock = app::clock_snapshot::capture(*clockSource, linkQuantum);
+    publishParameters();
 
     twister = new ofxBenG::twister();
     twister->bindToMultipleEncoders(&propertyBag);
     ofAddListener(twister->onEncoderPressed, this, &ofApp::onEncoderPressed);
-
-    timeline = new ofxBenG::timeline(0.0);
 }
 
-ofApp::ofApp() {}
+ofApp::ofApp(const std::string& clockScriptPath) : clockScriptPath(clockScriptPath) {}
 ofApp::~ofApp() {
     ofSoundStreamClose();
+    showLog.close(clockSource->getBeat());
     propertyBag.saveToXml();
-    delete ableton;
-    delete syphon;
+    delete clockSource;
+    delete videoDelay;
+    delete avSync;
+    delete bufferWatch;
+    delete publisher;
+    delete frameOutput;
     delete twister;
-    delete timeline;
+    delete samplePreroll;
+    delete effects;
+    delete engine;
+    delete sampleBank;
     delete audio;
 }
 
 void ofApp::update() {
-    float const beat = ableton->getBeat();
+    clock = app::clock_snapshot::capture(*clockSource, linkQuantum);
+    if (clock.tempo != loggedTempo) {
+        logEvent(app::show_log::tempo, clock.beat);
+        loggedTempo = clock.tempo;
+    }
     propertyBag.update();
+    publishParameters();
+
+    {
+        // Playing effects move playmodes play heads from the audio thread; see effect_guard.
+        std::lock_guard<app::effect_guard> guarded(effectGuard);
+        if (!playModes->isInitialized()) {
+            playModes->setup();
+        }
 
-    if (!playModes->isInitialized()) {
-        playModes->setup();
+        if (playModes->isInitialized()) {
+            playModes->update();
+        }
     }
 
-    if (playModes->isInitialized()) {
-        playModes->update();
+    // A sample picked by hand comes in on the next beat, prepared ahead so it is there for
+    // any effect starting on that beat too.
+    int const pressedIndex = pressedSample.exchange(-1);
+    if (pressedIndex >= 0) {
+        float const nextWholeBeat = clock.getNextWholeBeat();
+        logEvent(app::show_log::select, nextWholeBeat, pressedIndex);
+        samplePreroll->request(pressedIndex, nextWholeBeat);
+    }
+    app::effect_request requested;
+    while (engine->takeRequest(requested)) {
+        if (requested.generator >= cancelledGenerators) {
+            makeRequested(requested);
+        }
     }
+    samplePreroll->update(clock.beat, clock.tempo);
 
-    timeline->update(beat);
+    engine->sync(clock.beat, clock.tempo, clock.micros);
+    std::lock_guard<app::effect_guard> guarded(effectGuard);
+    engine->reclaim();
 }
 
 void ofApp::audioOut(float* output, int bufferSize, int nChannels) {
-    for (int i = 0; i < bufferSize; i++) {
-        float mix = audio->getMix();
-        output[nChannels * i] = mix;
-        output[nChannels * i + 1] = mix;
-    }
+    engine->render(output, bufferSize, nChannels);
 }
 
 void ofApp::draw(){
     ofBackground(0);
 
     if (playModes->isInitialized()) {
-        playModes->draw(0, 0, ofGetWidth(), ofGetHeight());
+        // The picture is drawn for the beat being rendered and shown once that beat is heard.
+        uint64_t const now = ofGetElapsedTimeMicros();
+        double const audibleBeat = avSync->getAudibleBeat(now);
+        videoDelay->begin();
+        {
+            // Only what reads play heads is guarded, so an audio block seldom finds it held.
+            std::lock_guard<app::effect_guard> guarded(effectGuard);
+            playModes->draw(0, 0, playModes->getWidth(), playModes->getHeight());
+            for (int i = 0; i < playModes->getBufferCount(); i++) {
+                bufferTextures[i] = &playModes->getBufferTexture(i);
+            }
+        }
+        videoDelay->end(avSync->getRenderedBeat(now));
+        double const shownBeat = videoDelay->draw(avCompensation ? audibleBeat : std::numeric_limits<double>::infinity(),
+                0, 0, ofGetWidth(), ofGetHeight());
+        avSync->record(shownBeat, audibleBeat, now);
+
+        // Published buffers are not delayed; see video_delay.
+        bufferWatch->compare([this](int i) -> ofTexture& { return *bufferTextures[i]; }, *publisher);
+        publisher->beginFrame();
         for (int i = 0; i < playModes->getBufferCount(); i++) {
-            syphon->publishTexture(i, &playModes->getBufferTexture(i));
+            publisher->publish(i, bufferTextures[i]);
         }
     }
 
     if (!inFullscreen) {
         float y = 15;
-        ofxBenG::utilities::drawLabelValue("beat", ableton->getBeat(), y);
-        ofxBenG::utilities::drawLabelValue("bpm", ableton->getTempo(), y += 20);
+        ofxBenG::utilities::drawLabelValue("beat", clock.beat, y);
+        ofxBenG::utilities::drawLabelValue("phase", clock.phase, y += 20);
+        ofxBenG::utilities::drawLabelValue("bpm", clock.tempo, y += 20);
         ofxBenG::utilities::drawLabelValue("recordLengthBeats", recordLengthBeats, y += 20);
         ofxBenG::utilities::drawLabelValue("stutterLengthBeats", stutterLengthBeats, y += 20);
         ofxBenG::utilities::drawLabelValue("rewindLengthBeats", rewindLengthBeats, y += 20);
+        ofxBenG::utilities::drawLabelValue("outputGain", outputGain, y += 20);
+        ofxBenG::utilities::drawLabelValue("sampleBankMB", sampleBank->getResidentBytes() / (1024.0f * 1024.0f), y += 20);
+        ofxBenG::utilities::drawLabelValue("voices", engine->getVoices().getActiveCount(), y += 20);
+        ofxBenG::utilities::drawLabelValue("voicesStolen", engine->getVoices().getStolenCount(), y += 20);
+        ofxBenG::utilities::drawLabelValue("generatorsPlaying", engine->getVoices().getBackgroundCount(), y += 20);
+        ofxBenG::utilities::drawLabelValue("effectBlocksDeferred", engine->getDeferredBlocks(), y += 20);
+        ofxBenG::utilities::drawLabelValue("generatorsLive", generatorPool.getLiveCount(), y += 20);
+        ofxBenG::utilities::drawLabelValue("generatorsUnpooled", generatorPool.getOverflowCount(), y += 20);
+        ofxBenG::utilities::drawLabelValue("samplesLate", samplePreroll->getLateCount(), y += 20);
+        ofxBenG::utilities::drawLabelValue("outputLatencyMs", audioProfile.getOutputLatencyMillis(), y += 20);
+        auto& stats = engine->getStats();
+        ofxBenG::utilities::drawLabelValue("callbackBudgetUs", stats.getDeadlineMicros(), y += 20);
+        ofxBenG::utilities::drawLabelValue("callbackP50Us", stats.getPercentileMicros(0.5), y += 20);
+        ofxBenG::utilities::drawLabelValue("callbackP99Us", stats.getPercentileMicros(0.99), y += 20);
+        ofxBenG::utilities::drawLabelValue("callbackMaxUs", stats.getMaxMicros(), y += 20);
+        ofxBenG::utilities::drawLabelValue("nearMisses", stats.getNearMisses(), y += 20);
+        ofxBenG::utilities::drawLabelValue("xruns", stats.getXruns(), y += 20);
+        ofxBenG::utilities::drawLabelValue("avCompensation", avCompensation ? 1 : 0, y += 20);
+        ofxBenG::utilities::drawLabelValue("avOffsetMs", avSync->getOffsetMillis(), y += 20);
+        ofxBenG::utilities::drawLabelValue("avOffsetMeanMs", avSync->getMeanOffsetMillis(), y += 20);
+        ofxBenG::utilities::drawLabelValue("avOffsetWorstMs", avSync->getWorstOffsetMillis(), y += 20);
+        ofxBenG::utilities::drawLabelValue("buffersPublished", publisher->getPublishedLastFrame(), y += 20);
+        ofxBenG::utilities::drawLabelValue("buffersSkipped", publisher->getSkippedLastFrame(), y += 20);
     }
 }
 
 void ofApp::onEncoderPressed(int& encoder) {
-    loadSample(encoder);
+    pressedSample = encoder;
 }
 
 void ofApp::log(float beat, const string &message) const {
@@ -102,40 +226,109 @@ void ofApp::keyPressed(int key) {
 }
 
 void ofApp::keyReleased(int key) {
-    float nextWholeBeat = ableton->getNextWholeBeat();
+    uint64_t const now = ofGetElapsedTimeMicros();
+    float const nextWholeBeat = clock.getNextWholeBeat(now);
 
     if (key == 'f') {
         ofToggleFullscreen();
         inFullscreen = !inFullscreen;
     }
 
+    if (key == 'a') {
+        avCompensation = !avCompensation;
+    }
+
+    if (key == 'd') {
+        std::string const path = ofToDataPath("callback-stats-" + ofGetTimestampString() + ".txt");
+        if (engine->getStats().dump(path)) {
+            log(nextWholeBeat, "wrote " + path);
+        }
+    }
+
     if (key == 's') {
-        auto stutter = ofxBenG::stutter::make_random(nextWholeBeat, beatsPerMinute, playModes, &forwardSample, audio);
-        timeline->schedule(stutter, nextWholeBeat);
+        app::effect_request pressed = {app::effect_request::stutter, nextWholeBeat, published.beatsPerMinute, 0, 0, 0};
+        std::lock_guard<app::effect_guard> guarded(effectGuard);
+        auto stutter = effects->make(pressed.what, pressed.beat, pressed.beatsPerMinute, pressed.seed);
+        engine->schedule(stutter, nextWholeBeat);
+        logEffect(pressed);
     }
 
     if (key == 'r') {
-        auto rewind = ofxBenG::rewind::make_random(nextWholeBeat, beatsPerMinute, playModes, &forwardSample, &backwardSample, audio);
-        timeline->schedule(rewind, nextWholeBeat);
+        app::effect_request pressed = {app::effect_request::rewind, nextWholeBeat, published.beatsPerMinute, 0, 0, 0};
+        std::lock_guard<app::effect_guard> guarded(effectGuard);
+        auto rewind = effects->make(pressed.what, pressed.beat, pressed.beatsPerMinute, pressed.seed);
+        engine->schedule(rewind, nextWholeBeat);
+        logEffect(pressed);
     }
 
     if (key == ' ') {
-        auto effectGenerator = new ofxBenG::effect_generator(nextWholeBeat,
-                beatsPerMinute, recordLengthBeats, rewindLengthBeats, stutterLengthBeats,
-                playModes, &forwardSample, &backwardSample, audio);
-        ofAddListener(effectGenerator->onEffectScheduled, this, &ofApp::onEffectScheduled);
-        timeline->schedule(effectGenerator, nextWholeBeat);
+        uint32_t const seed = effects->makeGeneratorSeed();
+        uint64_t const id = nextGenerator++;
+        auto effectGenerator = generatorPool.make(engine, seed, id);
+        generators.push_back(engine->schedule(effectGenerator, nextWholeBeat, true));
+        logEvent(app::show_log::generator, nextWholeBeat, -1, seed, id);
     }
+
+    if (key == 'x') {
+        for (uint64_t generator : generators) {
+            engine->cancel(generator);
+        }
+        generators.clear();
+        // Effects they asked for that are still queued are dropped too.
+        cancelledGenerators = nextGenerator;
+        logEvent(app::show_log::cancel, clock.getBeatAt(now));
+    }
+}
+
+// A generator asks about a beat ahead; each of its effects plays the next sample in turn.
+void ofApp::makeRequested(const app::effect_request& requested) {
+    std::lock_guard<app::effect_guard> guarded(effectGuard);
+    auto made = effects->remake(requested.what, requested.beat, requested.beatsPerMinute, requested.seed);
+    engine->schedule(made, requested.beat);
+    logEffect(requested);
+    int const sample = requested.count % sampleBank->size();
+    samplePreroll->request(sample, requested.beat);
+    logEvent(app::show_log::select, requested.beat, sample, 0, requested.generator);
+}
+
+void ofApp::logEvent(app::show_log::type what, double beat, int index, uint32_t seed, uint64_t generator) {
+    auto happened = app::show_log::makeEvent(what, beat, index);
+    happened.beatsPerMinute = (float) clock.tempo;
+    happened.recordLengthBeats = published.recordLengthBeats;
+    happened.rewindLengthBeats = published.rewindLengthBeats;
+    happened.stutterLengthBeats = published.stutterLengthBeats;
+    happened.seed = seed;
+    happened.generator = (uint32_t) generator;
+    showLog.write(happened);
+}
+
+// Logged with the tempo the effect was made with, which for a generator's is its block's.
+void ofApp::logEffect(const app::effect_request& made) {
+    auto const what = made.what == app::effect_request::stutter ? app::show_log::stutter : app::show_log::rewind;
+    auto happened = app::show_log::makeEvent(what, made.beat);
+    happened.beatsPerMinute = made.beatsPerMinute;
+    happened.recordLengthBeats = published.recordLengthBeats;
+    happened.rewindLengthBeats = published.rewindLengthBeats;
+    happened.stutterLengthBeats = published.stutterLengthBeats;
+    happened.seed = made.seed;
+    happened.generator = (uint32_t) made.generator;
+    showLog.write(happened);
 }
 
-void ofApp::onEffectScheduled(int& totalEffectsScheduled) {
-    loadSample(totalEffectsScheduled % samples.size());
+// Effects made this frame, and what is logged with them, work from the same copy the engine is
+// sent; effects playing on the audio thread read the engine's smoothed one.
+void ofApp::publishParameters() {
+    // A simulated clock ignores the encoder, so effects follow the script's tempo instead.
+    published.beatsPerMinute = simulatedClock ? (float) clock.tempo : (float) beatsPerMinute;
+    published.recordLengthBeats = recordLengthBeats;
+    published.rewindLengthBeats = rewindLengthBeats;
+    published.stutterLengthBeats = stutterLengthBeats;
+    published.outputGain = outputGain;
+    engine->publishParameters(published);
 }
 
 void ofApp::loadSample(int index) {
-    auto mySample = samples[index];
-    forwardSample.load(ofToDataPath(mySample.forwards));
-    backwardSample.load(ofToDataPath(mySample.backwards));
+    samplePreroll->request(index);
 }
 
 void ofApp::mouseMoved(int x, int y) {
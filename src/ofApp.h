@@ -2,14 +2,33 @@
 
 #include "ofMain.h"
 #include "ofxBenG.h"
+#ifdef TARGET_OSX
 #include "ofxSyphon.h"
+#endif
 #include "ofxMaxim.h"
 #include "ofxPS3EyeGrabber.h"
 #include "ofxMaxim.h"
+#include "audio_engine.h"
+#include "audio_profile.h"
+#include "av_sync.h"
+#include "clock_snapshot.h"
+#include "clock_source.h"
+#include "buffer_publisher.h"
+#include "buffer_watch.h"
+#include "effect_factory.h"
+#include "effect_generator.h"
+#include "effect_guard.h"
+#include "effect_pool.h"
+#include "sample_preroll.h"
+#include "shm_frame_server.h"
+#include "show_log.h"
+#include "simulated_clock.h"
+#include "video_delay.h"
 
 class ofApp : public ofBaseApp {
 public:
-    ofApp();~ofApp();
+    // With a clock script, the app runs on a simulated_clock instead of Link.
+    explicit ofApp(const std::string& clockScriptPath = "");~ofApp();
 	void setup();
 	void update();
 	void draw();
@@ -30,28 +49,52 @@ public:
 	// App
 	void log(float beat, const string &message) const;
     void onEncoderPressed(int& encoder);
-	void onEffectScheduled(int& totalEffectsScheduled);
+	void makeRequested(const app::effect_request& requested);
 	void loadSample(int index);
-	struct sample {
-		std::string forwards;
-		std::string backwards;
-	};
-	std::vector<sample> samples;
-    ofxBenG::ableton* ableton;
+	void logEvent(app::show_log::type what, double beat, int index = -1, uint32_t seed = 0, uint64_t generator = 0);
+	void logEffect(const app::effect_request& made);
+	void publishParameters();
+    app::clock_source* clockSource;
+    std::string clockScriptPath;
+    app::simulated_clock::script clockScript;
+    bool simulatedClock = false;
+	app::clock_snapshot clock;
+	double loggedTempo = 0;
     ofxBenG::twister* twister;
     ofxBenG::playmodes* playModes;
-	ofxBenG::syphon* syphon;
+	app::frame_publisher* frameOutput;
+	app::buffer_publisher* publisher;
+	app::buffer_watch* bufferWatch;
+	std::vector<ofTexture*> bufferTextures;
+	app::av_sync* avSync;
+	app::video_delay* videoDelay;
+	bool avCompensation = true;
 	ofxBenG::audio* audio;
-	ofxBenG::timeline* timeline = nullptr;
+	app::audio_engine* engine;
+	app::effect_factory* effects;
+	app::effect_guard effectGuard;
     ofxBenG::property_bag propertyBag;
     ofxBenG::property<float> beatsPerMinute = {"beatsPerMinute", 60, 0, 480};
     ofxBenG::property<float> recordLengthBeats = {"recordLengthBeats", 0.25, 0.0, 8.0};
     ofxBenG::property<float> rewindLengthBeats = {"rewindLengthBeats", 0.0, 0.0, 8.0};
 	ofxBenG::property<float> stutterLengthBeats = {"stutterLengthBeats", 0.25, 0.0, 8.0};
+	ofxBenG::property<float> outputGain = {"outputGain", 1.0, 0.0, 1.0};
+	app::show_parameters::values published;
     static float constexpr width = 1280;
     static float constexpr height = width / (1920.0/1080.0);
+    static int constexpr cameraFramesPerSecond = 60;
+    // Drawn frames between forced republishes of a buffer nothing marked dirty.
+    static int constexpr bufferRefreshFrames = 60;
+    static float constexpr linkQuantum = 8;
     bool inFullscreen = false;
-	ofxMaxiSample forwardSample;
-	ofxMaxiSample backwardSample;
+	app::sample_bank* sampleBank;
+	app::sample_preroll* samplePreroll;
+	std::atomic<int> pressedSample{-1};
+	app::show_log showLog;
+	std::vector<uint64_t> generators;
+	app::effect_pool<app::effect_generator> generatorPool{16};
+	uint64_t nextGenerator = 1;
+	uint64_t cancelledGenerators = 1;
+	app::audio_profile audioProfile;
 	int audioBufferSize, sampleRate;
 };
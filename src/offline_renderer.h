@@ -0,0 +1,399 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "ofMain.h"
+#include "ofxBenG.h"
+#include "audio_engine.h"
+#include "effect_factory.h"
+#include "effect_generator.h"
+#include "effect_pool.h"
+#include "sample_bank.h"
+#include "show_log.h"
+#include "wav_writer.h"
+
+namespace app {
+
+/**
+ * Renders a scripted performance to a WAV file as fast as the CPU allows, with no window and
+ * no sound device. The beat clock is simulated: it starts at beat 0 at the script's tempo
+ * and advances only by the frames rendered, so a script always renders the same way.
+ *
+ * A script is plain text, one directive per line:
+ *
+ *     bpm 120
+ *     beats 32
+ *     sampleRate 44100
+ *     bufferSize 512
+ *     seed 1
+ *     stutterLengthBeats 0.25
+ *     sample fancyfort-forwards.wav
+ *     at 4 stutter
+ *     at 8 rewind
+ *     at 12 generator
+ *     at 16 select 1
+ *     at 20 tempo 140
+ *     at 24 cancel
+ *
+ * Samples are registered in order, resolved against the data folder like the live app's, and
+ * the first one is selected before rendering starts. A cancel stops every generator scheduled
+ * before it. Effects are made by an effect_factory
+ * seeded with the script's seed, so a script renders the same way every time. Effects a generator asks
+ * for are made between blocks, and the samples it rotates through are selected at the top of
+ * the block their beat falls in, as a scripted select is. A tempo change likewise takes effect
+ * from the top of the block its beat falls in.
+ *
+ * A show_log recorded by the live app can be rendered in place of a script; see replay().
+ */
+class offline_renderer {
+public:
+    // A replayed stutter or rewind is made with the tempo and seed it was made with live; a
+    // tempo event carries the tempo the clock changes to.
+    struct event {
+        double beat;
+        std::string type;
+        int index;
+        bool replayed;
+        float beatsPerMinute;
+        uint32_t seed;
+    };
+
+    struct script {
+        float bpm = 120;
+        double lengthBeats = 16;
+        int sampleRate = 44100;
+        int bufferSize = 512;
+        uint32_t seed = 1;
+        float recordLengthBeats = 0.25;
+        float rewindLengthBeats = 0;
+        float stutterLengthBeats = 0.25;
+        std::vector<std::string> samples;
+        std::vector<event> events;
+
+        bool parse(const std::string& path);
+        bool load(const std::string& logPath);
+    };
+
+    static int run(const std::string& scriptPath, const std::string& outputPath) {
+        script parsed;
+        if (!parsed.parse(scriptPath)) {
+            return 1;
+        }
+        offline_renderer renderer(parsed);
+        return renderer.render(outputPath) ? 0 : 1;
+    }
+
+    // Renders a show recorded by the live app.
+    static int replay(const std::string& logPath, const std::string& outputPath) {
+        script loaded;
+        if (!loaded.load(logPath)) {
+            return 1;
+        }
+        ofLogNotice("offline_renderer") << "replaying " << loaded.events.size() << " events over "
+                                        << loaded.lengthBeats << " beats with seed " << loaded.seed;
+        offline_renderer renderer(loaded);
+        return renderer.render(outputPath) ? 0 : 1;
+    }
+
+private:
+    explicit offline_renderer(const script& performance)
+            : performance(performance) {}
+
+    bool render(const std::string& outputPath) {
+        int const nChannels = 2;
+        float const bpm = performance.bpm;
+        int const sampleRate = performance.sampleRate;
+        int const bufferSize = performance.bufferSize;
+        auto& events = performance.events;
+
+        wav_writer output;
+        if (!output.open(outputPath, sampleRate, nChannels)) {
+            ofLogError("offline_renderer") << "cannot write " << outputPath;
+            return false;
+        }
+
+        audio = new ofxBenG::audio(sampleRate, nChannels, bufferSize);
+        // As in ofApp, the camera is only opened by setup(), which is never called here.
+        playModes = new ofxBenG::playmodes(ofxBenG::playmodes::c920, 1280, 720, 60);
+        for (auto& sample : performance.samples) {
+            bank.add(sample);
+        }
+        bank.preload();
+        engine = new audio_engine(audio, &bank, sampleRate, bufferSize, maxVoices);
+        effects = new effect_factory(playModes, &bank, audio, performance.seed);
+        engine->setRecycler([this](ofxBenG::beat_action* effect) { return generatorPool.release(effect); });
+        engine->sync(0, bpm, 0);
+        show_parameters::values parameters;
+        parameters.beatsPerMinute = bpm;
+        parameters.recordLengthBeats = performance.recordLengthBeats;
+        parameters.rewindLengthBeats = performance.rewindLengthBeats;
+        parameters.stutterLengthBeats = performance.stutterLengthBeats;
+        engine->publishParameters(parameters);
+        std::vector<float> block(bufferSize * nChannels);
+
+        select(0);
+        auto const startTime = std::chrono::steady_clock::now();
+        // The beat is tracked as the engine's clock advances it, a block at a time at the
+        // current tempo, so a tempo change moves every later event's frame.
+        double beat = 0;
+        long frame = 0;
+        size_t nextEvent = 0;
+        while (beat < performance.lengthBeats) {
+            uint64_t const micros = (uint64_t) (frame * 1000000.0 / sampleRate);
+            double const blockEnd = beat + bufferSize * parameters.beatsPerMinute / 60.0 / sampleRate;
+            while (nextEvent < events.size() && events[nextEvent].beat < blockEnd) {
+                auto& scheduled = events[nextEvent++];
+                if (scheduled.type == "tempo") {
+                    parameters.beatsPerMinute = scheduled.beatsPerMinute;
+                    engine->sync(beat, parameters.beatsPerMinute, micros);
+                    engine->publishParameters(parameters);
+                } else {
+                    trigger(scheduled, parameters.beatsPerMinute);
+                }
+            }
+
+            for (size_t i = 0; i < rotations.size();) {
+                if (rotations[i].beat < blockEnd) {
+                    select(rotations[i].index);
+                    rotations.erase(rotations.begin() + i);
+                } else {
+                    i++;
+                }
+            }
+
+            double const beatsPerFrame = parameters.beatsPerMinute / 60.0 / sampleRate;
+            int const frames = (int) std::min<double>(bufferSize,
+                    std::ceil((performance.lengthBeats - beat) / beatsPerFrame));
+            engine->render(block.data(), frames, nChannels, micros);
+            output.write(block.data(), frames);
+            beat += frames * beatsPerFrame;
+            frame += frames;
+            effect_request requested;
+            while (engine->takeRequest(requested)) {
+                if (requested.generator >= cancelledGenerators) {
+                    makeRequested(requested);
+                }
+            }
+            engine->reclaim();
+        }
+
+        double const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        double const rendered = (double) frame / sampleRate;
+        ofLogNotice("offline_renderer") << "rendered " << rendered << " s in " << elapsed << " s ("
+                                        << (elapsed > 0 ? rendered / elapsed : 0) << "x realtime) to " << outputPath;
+        // The stats keep the deadline of the last block, which is usually a partial one.
+        auto& stats = engine->getStats();
+        double const budgetMicros = bufferSize * 1000000.0 / sampleRate;
+        ofLogNotice("offline_renderer") << "block render p50 " << stats.getPercentileMicros(0.5) << " us, p99 "
+                                        << stats.getPercentileMicros(0.99) << " us, max " << stats.getMaxMicros()
+                                        << " us against a " << budgetMicros << " us budget";
+
+        delete engine;
+        delete effects;
+        delete playModes;
+        delete audio;
+        return output.close();
+    }
+
+    void trigger(const event& scheduled, float beatsPerMinute) {
+        if (scheduled.type == "stutter" || scheduled.type == "rewind") {
+            auto const what = scheduled.type == "stutter" ? effect_request::stutter : effect_request::rewind;
+            uint32_t seed = scheduled.seed;
+            auto made = scheduled.replayed
+                    ? effects->remake(what, scheduled.beat, scheduled.beatsPerMinute, seed)
+                    : effects->make(what, scheduled.beat, beatsPerMinute, seed);
+            engine->schedule(made, scheduled.beat);
+        } else if (scheduled.type == "generator") {
+            auto effectGenerator = generatorPool.make(engine, effects->makeGeneratorSeed(), nextGenerator++);
+            generators.push_back(engine->schedule(effectGenerator, scheduled.beat, true));
+        } else if (scheduled.type == "cancel") {
+            for (uint64_t generator : generators) {
+                engine->cancel(generator);
+            }
+            generators.clear();
+            cancelledGenerators = nextGenerator;
+        } else if (scheduled.type == "select") {
+            select(scheduled.index);
+        } else {
+            ofLogWarning("offline_renderer") << "unknown event " << scheduled.type << " at beat " << scheduled.beat;
+        }
+    }
+
+    void makeRequested(const effect_request& requested) {
+        engine->schedule(effects->remake(requested.what, requested.beat, requested.beatsPerMinute, requested.seed),
+                requested.beat);
+        event const rotation = {requested.beat, "select", requested.count % bank.size(), false, 0, 0};
+        rotations.push_back(rotation);
+    }
+
+    // A live show carries on while a sample decodes; a render waits so every run is identical.
+    void select(int index) {
+        if (index < 0 || index >= bank.size()) {
+            return;
+        }
+        bank.select(index);
+        int prepared;
+        while ((prepared = bank.prepare()) < 0 && bank.isPreparing()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (prepared >= 0) {
+            engine->selectSample(prepared);
+            engine->flush();
+        }
+    }
+
+    static int constexpr maxVoices = 8;
+
+    const script& performance;
+    uint64_t nextGenerator = 1;
+    uint64_t cancelledGenerators = 1;
+    std::vector<uint64_t> generators;
+    std::vector<event> rotations;
+    effect_pool<effect_generator> generatorPool{16};
+
+    sample_bank bank;
+    ofxBenG::audio* audio = nullptr;
+    ofxBenG::playmodes* playModes = nullptr;
+    audio_engine* engine = nullptr;
+    effect_factory* effects = nullptr;
+};
+
+inline bool offline_renderer::script::parse(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        ofLogError("offline_renderer") << "cannot read script " << path;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream words(line);
+        std::string directive;
+        if (!(words >> directive) || directive[0] == '#') {
+            continue;
+        }
+
+        bool ok = true;
+        if (directive == "bpm") {
+            ok = (bool) (words >> bpm) && bpm > 0;
+        } else if (directive == "beats") {
+            ok = (bool) (words >> lengthBeats);
+        } else if (directive == "sampleRate") {
+            ok = (bool) (words >> sampleRate);
+        } else if (directive == "bufferSize") {
+            ok = (bool) (words >> bufferSize);
+        } else if (directive == "seed") {
+            ok = (bool) (words >> seed);
+        } else if (directive == "recordLengthBeats") {
+            ok = (bool) (words >> recordLengthBeats);
+        } else if (directive == "rewindLengthBeats") {
+            ok = (bool) (words >> rewindLengthBeats);
+        } else if (directive == "stutterLengthBeats") {
+            ok = (bool) (words >> stutterLengthBeats);
+        } else if (directive == "sample") {
+            std::string sample;
+            ok = (bool) (words >> sample);
+            samples.push_back(sample);
+        } else if (directive == "at") {
+            event scheduled = {0, "", 0, false, 0, 0};
+            ok = (bool) (words >> scheduled.beat >> scheduled.type);
+            if (ok && scheduled.type == "select") {
+                ok = (bool) (words >> scheduled.index);
+            } else if (ok && scheduled.type == "tempo") {
+                ok = (bool) (words >> scheduled.beatsPerMinute) && scheduled.beatsPerMinute > 0;
+            }
+            events.push_back(scheduled);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            ofLogError("offline_renderer") << path << ":" << lineNumber << ": cannot parse \"" << line << "\"";
+            return false;
+        }
+    }
+
+    if (samples.empty()) {
+        ofLogError("offline_renderer") << path << ": no samples registered";
+        return false;
+    }
+    std::stable_sort(events.begin(), events.end(), [](const event& a, const event& b) {
+        return a.beat < b.beat;
+    });
+    return true;
+}
+
+// The live show starts wherever the Link timeline happens to be, so the replay is moved to
+// start a bar before the first event, keeping each event's place in the bar. The clock starts
+// at the Link tempo logged last before then and follows each tempo change logged after, and
+// every effect is made with the tempo and seed it was made with live.
+inline bool offline_renderer::script::load(const std::string& logPath) {
+    show_log::header header;
+    std::vector<show_log::event> logged;
+    if (!show_log::read(logPath, header, logged)) {
+        ofLogError("offline_renderer") << "cannot read show log " << logPath;
+        return false;
+    }
+    auto const first = std::find_if(logged.begin(), logged.end(), [](const show_log::event& happened) {
+        return happened.what != show_log::tempo;
+    });
+    if (header.samples.empty() || first == logged.end()) {
+        ofLogError("offline_renderer") << logPath << ": nothing to replay";
+        return false;
+    }
+
+    seed = header.seed;
+    sampleRate = header.sampleRate;
+    bufferSize = header.bufferSize;
+    samples = header.samples;
+    double const origin = std::max(0.0, std::floor(first->beat / 4) * 4 - 4);
+    bool parameters = false;
+    bool tempoKnown = false;
+    events.clear();
+    for (auto& happened : logged) {
+        double const beat = happened.beat - origin;
+        if (happened.what == show_log::end) {
+            lengthBeats = beat;
+            break;
+        }
+        if (happened.what == show_log::tempo) {
+            if (happened.beatsPerMinute <= 0) {
+                continue;
+            }
+            if (beat <= 0 || !tempoKnown) {
+                bpm = happened.beatsPerMinute;
+                tempoKnown = true;
+            }
+            if (beat > 0) {
+                event changed = {beat, "tempo", -1, true, happened.beatsPerMinute, 0};
+                events.push_back(changed);
+            }
+            continue;
+        }
+        if (happened.what != show_log::select && !parameters) {
+            recordLengthBeats = happened.recordLengthBeats;
+            rewindLengthBeats = happened.rewindLengthBeats;
+            stutterLengthBeats = happened.stutterLengthBeats;
+            parameters = true;
+        }
+        // A generator's effects and samples are in the log themselves, so it is not run again.
+        if (happened.what == show_log::generator || happened.what == show_log::cancel) {
+            continue;
+        }
+        event replayed = {beat, show_log::getName(happened.what), happened.index, true,
+                          happened.beatsPerMinute, happened.seed};
+        events.push_back(replayed);
+        lengthBeats = beat + 16;
+    }
+    std::stable_sort(events.begin(), events.end(), [](const event& a, const event& b) {
+        return a.beat < b.beat;
+    });
+    return true;
+}
+
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include "ofMain.h"
+#include "maxi_sample.h"
+#include "worker_thread.h"
+
+namespace app {
+
+struct sample_pair {
+    ofxMaxiSample forwards;
+    ofxMaxiSample backwards;
+};
+
+/**
+ * Every registered sample decoded once and kept resident, so switching samples never goes
+ * back to disk.
+ *
+ * The forward PCM of all samples lives in one cache-aligned arena, each sample in its own
+ * region starting on a cache line. The arena is laid out from the file sizes on the first
+ * require(), and each region is filled on the worker once its sample is decoded; ofxMaxiSample
+ * decodes into a buffer of its own, which is copied into the region and freed. A sample that
+ * turns out larger than its file keeps its own buffer.
+ *
+ * Only forward PCM is stored. The backward sample that rewind plays is derived from the
+ * selected forward sample on the worker thread, into a single spare buffer, so the bank
+ * holds one reversed buffer in flight rather than one per sample.
+ *
+ * Effects hold pointers to the live pair, which never moves. Selecting a sample on the audio
+ * thread returns the live forward PCM to the slot it came from, swaps the selected slot's PCM
+ * in, and swaps the spare's reversed PCM into the live backward sample. These are pointer
+ * exchanges: nothing is decoded, copied or freed on the audio thread.
+ *
+ * A selection goes through three threads: select() on the GL thread, the decode and reversal
+ * on the worker, then the swap on the audio thread once prepare() reports it ready.
+ */
+class sample_bank {
+public:
+    ~sample_bank() {
+        // The samples would otherwise free their arena regions one by one.
+        loader.stop();
+        release(live.forwards);
+        for (auto& each : slots) {
+            release(each->pcm);
+        }
+    }
+
+    // Register every sample before the first require(), which lays out the arena, and before
+    // the audio stream starts; the slot list is not synchronized.
+    int add(const std::string& path) {
+        std::unique_ptr<slot> added(new slot());
+        added->path = path;
+        slots.push_back(std::move(added));
+        return (int) slots.size() - 1;
+    }
+
+    int size() const {
+        return (int) slots.size();
+    }
+
+    const std::string& getPath(int index) const {
+        return slots[index]->path;
+    }
+
+    void preload() {
+        for (int i = 0; i < size(); i++) {
+            require(i);
+        }
+    }
+
+    // Control thread. Starts decoding the slot on first use; later calls are free.
+    void require(int index) {
+        if (arenaBytes == 0) {
+            layOut();
+        }
+        slot* required = slots[index].get();
+        if (required->requested.exchange(true)) {
+            return;
+        }
+        loader.post([this, required]() {
+            bool const loaded = required->pcm.load(ofToDataPath(required->path))
+                    && required->pcm.temp != nullptr && required->pcm.length > 0;
+            if (loaded) {
+                required->residentBytes = moveIntoArena(*required) ? 0 : (size_t) required->pcm.myDataSize;
+            } else {
+                ofLogError("sample_bank") << "cannot load " << required->path;
+                required->failed.store(true, std::memory_order_relaxed);
+            }
+            required->ready.store(true, std::memory_order_release);
+        });
+    }
+
+    // The arena plus any sample that did not fit in it.
+    size_t getResidentBytes() const {
+        size_t total = arenaBytes + reversedBytes.load(std::memory_order_relaxed);
+        for (auto& each : slots) {
+            if (each->ready.load(std::memory_order_acquire)) {
+                total += each->residentBytes;
+            }
+        }
+        return total;
+    }
+
+    ofxMaxiSample* getForwards() {
+        return &live.forwards;
+    }
+
+    ofxMaxiSample* getBackwards() {
+        return &live.backwards;
+    }
+
+    // Control thread. A sample that failed to load is never selected; one still loading is
+    // dropped by prepare() if it fails.
+    void select(int index) {
+        require(index);
+        if (isFailed(index)) {
+            ofLogWarning("sample_bank") << "not selecting " << slots[index]->path << ", which failed to load";
+            return;
+        }
+        pending = index;
+    }
+
+    // Control thread.
+    bool isPreparing() const {
+        return pending >= 0;
+    }
+
+    // Control thread, once per frame. Returns a sample that is ready to be swapped in on the
+    // audio thread, or -1 while the last selection is still being prepared.
+    int prepare() {
+        if (pending < 0) {
+            return -1;
+        }
+        if (pending == sent) {
+            pending = -1;
+            return -1;
+        }
+
+        // Until the audio thread applies the last selection it still owns the spare and the
+        // outgoing slot, so the worker may not touch either.
+        if (applied.load(std::memory_order_acquire) != sent) {
+            return -1;
+        }
+        if (!slots[pending]->ready.load(std::memory_order_acquire)) {
+            return -1;
+        }
+        if (isFailed(pending)) {
+            ofLogWarning("sample_bank") << "not selecting " << slots[pending]->path << ", which failed to load";
+            pending = -1;
+            return -1;
+        }
+
+        if (reversing < 0) {
+            reversing = pending;
+            slot* source = slots[reversing].get();
+            int const index = reversing;
+            reversed.store(-1, std::memory_order_relaxed);
+            loader.post([this, source, index]() {
+                reverseInto(source->pcm, spare);
+                reversedBytes = 2 * (size_t) spare.myDataSize;
+                reversed.store(index, std::memory_order_release);
+            });
+            return -1;
+        }
+        if (reversed.load(std::memory_order_acquire) != reversing) {
+            return -1;
+        }
+
+        // The selection changed while the worker was reversing; start over with the new one.
+        bool const stale = reversing != pending;
+        reversing = -1;
+        if (stale) {
+            return -1;
+        }
+
+        sent = pending;
+        pending = -1;
+        return sent;
+    }
+
+    // Audio thread.
+    void apply(int index) {
+        wanted = index;
+    }
+
+    // Audio thread, at a block boundary. Wait-free.
+    void publish() {
+        if (wanted == current || wanted < 0 || wanted >= size()) {
+            return;
+        }
+        if (current >= 0) {
+            swapStorage(live.forwards, slots[current]->pcm);
+        }
+        swapStorage(live.forwards, slots[wanted]->pcm);
+        swapStorage(live.backwards, spare);
+        current = wanted;
+        applied.store(current, std::memory_order_release);
+    }
+
+private:
+    static size_t constexpr cacheLine = 64;
+
+    struct slot {
+        std::string path;
+        ofxMaxiSample pcm;
+        size_t offset = 0;
+        size_t capacity = 0;
+        size_t residentBytes = 0;
+        std::atomic<bool> requested{false};
+        std::atomic<bool> ready{false};
+        std::atomic<bool> failed{false};
+    };
+
+    // A WAV file is never smaller than the PCM decoded from it, so each region is sized from
+    // its file, rounded up to whole cache lines.
+    void layOut() {
+        size_t total = 0;
+        for (auto& each : slots) {
+            std::ifstream file(ofToDataPath(each->path), std::ios::binary | std::ios::ate);
+            std::streamoff const fileBytes = file ? (std::streamoff) file.tellg() : 0;
+            each->offset = total;
+            each->capacity = fileBytes > 0 ? ((size_t) fileBytes + cacheLine - 1) / cacheLine * cacheLine : 0;
+            total += each->capacity;
+        }
+        if (total == 0) {
+            return;
+        }
+        storage.reset(new char[total + cacheLine - 1]);
+        uintptr_t const address = reinterpret_cast<uintptr_t>(storage.get());
+        arena = storage.get() + (cacheLine - address % cacheLine) % cacheLine;
+        arenaBytes = total;
+    }
+
+    // Worker thread.
+    bool moveIntoArena(slot& decoded) {
+        ofxMaxiSample& pcm = decoded.pcm;
+        size_t const bytes = (size_t) pcm.length * sizeof(short);
+        if (pcm.temp == nullptr || bytes == 0) {
+            return true;
+        }
+        if (bytes > decoded.capacity) {
+            ofLogWarning("sample_bank") << decoded.path << " decoded larger than its file; keeping it outside the arena";
+            return false;
+        }
+        char* const region = arena + decoded.offset;
+        std::memcpy(region, pcm.temp, bytes);
+        std::free(pcm.temp);
+        pcm.temp = reinterpret_cast<short*>(region);
+        return true;
+    }
+
+    bool isFailed(int index) const {
+        return slots[index]->ready.load(std::memory_order_acquire)
+                && slots[index]->failed.load(std::memory_order_relaxed);
+    }
+
+    void release(ofxMaxiSample& sample) {
+        char* const data = reinterpret_cast<char*>(sample.temp);
+        if (arena != nullptr && data >= arena && data < arena + arenaBytes) {
+            sample.temp = nullptr;
+        }
+    }
+
+    std::unique_ptr<char[]> storage;
+    char* arena = nullptr;
+    size_t arenaBytes = 0;
+    std::vector<std::unique_ptr<slot>> slots;
+    sample_pair live;
+    ofxMaxiSample spare;
+    std::atomic<size_t> reversedBytes{0};
+    std::atomic<int> reversed{-1};
+    std::atomic<int> applied{-1};
+
+    // Control thread only.
+    int pending = -1;
+    int sent = -1;
+    int reversing = -1;
+
+    // Audio thread only.
+    int wanted = -1;
+    int current = -1;
+
+    worker_thread loader;
+};
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include "ofMain.h"
+#include "audio_engine.h"
+#include "sample_bank.h"
+
+namespace app {
+
+/**
+ * Sample selections that take effect on a beat. Reversing a sample for rewind takes the
+ * worker tens of milliseconds, so a selection made on the beat an effect starts would reach
+ * the audio thread after the effect had already started on the old sample.
+ *
+ * Instead, a selection is requested for a beat. Once that beat is within the lookahead
+ * window the bank starts preparing it on its worker; once it is ready the audio engine is
+ * told to swap it in on the sample the beat falls on, which is a few pointer exchanges. A
+ * selection that is still being prepared when its beat arrives is swapped in as soon as it
+ * is ready, and counted as late.
+ *
+ * The bank prepares one selection at a time, so a new request replaces one that is waiting.
+ * Control thread only.
+ */
+class sample_preroll {
+public:
+    sample_preroll(sample_bank* bank, audio_engine* engine, float lookaheadMillis)
+            : bank(bank), engine(engine), lookaheadMillis(lookaheadMillis) {}
+
+    // Without a beat, the sample is swapped in as soon as it is ready.
+    void request(int index, double beat = -std::numeric_limits<double>::infinity()) {
+        if (index < 0 || index >= bank->size()) {
+            return;
+        }
+        wanted = index;
+        wantedBeat = beat;
+        preparing = false;
+    }
+
+    // Once per frame.
+    void update(double beat, double tempo) {
+        if (wanted >= 0 && !preparing) {
+            double const millisAhead = tempo > 0 ? (wantedBeat - beat) * 60000.0 / tempo : 0;
+            if (millisAhead <= lookaheadMillis) {
+                bank->select(wanted);
+                preparing = true;
+            }
+        }
+
+        int const prepared = bank->prepare();
+        if (prepared < 0) {
+            if (preparing && !bank->isPreparing()) {
+                // The bank already had it selected.
+                wanted = -1;
+                preparing = false;
+            }
+            return;
+        }
+        if (preparing && prepared == wanted) {
+            if (std::isfinite(wantedBeat) && beat >= wantedBeat) {
+                lateCount++;
+            }
+            engine->selectSample(prepared, wantedBeat);
+            wanted = -1;
+            preparing = false;
+        } else {
+            engine->selectSample(prepared);
+        }
+    }
+
+    uint64_t getLateCount() const {
+        return lateCount;
+    }
+
+private:
+    sample_bank* bank;
+    audio_engine* engine;
+    float lookaheadMillis;
+    int wanted = -1;
+    double wantedBeat = 0;
+    bool preparing = false;
+    uint64_t lateCount = 0;
+};
+
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#ifdef __linux__
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace app {
+
+/**
+ * The layout of the shared-memory frame ring written by shm_frame_server. It depends on
+ * nothing but the standard library so that consumers can include it on its own.
+ *
+ * One POSIX shared-memory object holds a 64-byte header followed by one region per buffer.
+ * A region is a 64-byte buffer header and slotCount slots; a slot is a 64-byte slot header
+ * followed by the pixels, tightly packed rows of 8-bit channels, top row first.
+ *
+ * Each slot is a seqlock. The writer makes the slot's sequence odd, writes the frame, makes
+ * it even again, and only then advances the buffer's published count. A reader loads the
+ * published count, reads the slot it points at straight out of the mapping, and checks that
+ * the sequence was even and unchanged across the read; if not, the frame was overwritten
+ * under it and is discarded. The published count doubles as a futex word on Linux, so a
+ * reader can sleep until the next frame.
+ */
+namespace shm_frames {
+
+uint32_t constexpr magic = 0x53545446;
+uint32_t constexpr version = 1;
+size_t constexpr blockBytes = 64;
+
+struct header {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t bufferCount;
+    uint32_t slotCount;
+    uint64_t slotBytes;
+    uint64_t slotStride;
+    uint64_t bufferStride;
+};
+
+struct buffer_header {
+    std::atomic<uint32_t> published;
+};
+
+struct slot_header {
+    std::atomic<uint32_t> sequence;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint64_t frame;
+    uint64_t micros;
+};
+
+static_assert(sizeof(header) <= blockBytes, "header must fit in its block");
+static_assert(sizeof(buffer_header) <= blockBytes, "buffer_header must fit in its block");
+static_assert(sizeof(slot_header) <= blockBytes, "slot_header must fit in its block");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "atomics must be plain words to be shared");
+
+inline uint64_t roundUp(uint64_t bytes) {
+    return (bytes + blockBytes - 1) / blockBytes * blockBytes;
+}
+
+inline uint64_t getSlotStride(uint64_t slotBytes) {
+    return blockBytes + roundUp(slotBytes);
+}
+
+inline uint64_t getBufferStride(uint32_t slotCount, uint64_t slotBytes) {
+    return blockBytes + slotCount * getSlotStride(slotBytes);
+}
+
+inline uint64_t getTotalBytes(uint32_t bufferCount, uint32_t slotCount, uint64_t slotBytes) {
+    return blockBytes + bufferCount * getBufferStride(slotCount, slotBytes);
+}
+
+inline buffer_header* getBuffer(void* base, int buffer) {
+    header* mapped = (header*) base;
+    return (buffer_header*) ((uint8_t*) base + blockBytes + buffer * mapped->bufferStride);
+}
+
+inline slot_header* getSlot(void* base, int buffer, int slot) {
+    header* mapped = (header*) base;
+    return (slot_header*) ((uint8_t*) getBuffer(base, buffer) + blockBytes + slot * mapped->slotStride);
+}
+
+inline uint8_t* getPixels(slot_header* slot) {
+    return (uint8_t*) slot + blockBytes;
+}
+
+inline void wake(std::atomic<uint32_t>& word) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*) &word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void) word;
+#endif
+}
+
+// Returns once word is no longer seen or the timeout passes, whichever is first. Without a
+// futex this polls.
+inline void wait(std::atomic<uint32_t>& word, uint32_t seen, int timeoutMillis) {
+#ifdef __linux__
+    timespec timeout = {timeoutMillis / 1000, (timeoutMillis % 1000) * 1000000L};
+    syscall(SYS_futex, (uint32_t*) &word, FUTEX_WAIT, seen, &timeout, nullptr, 0);
+#else
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    while (word.load(std::memory_order_acquire) == seen && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+#endif
+}
+
+}
+
+}
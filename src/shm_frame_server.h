@@ -0,0 +1,179 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include "ofMain.h"
+#include "frame_publisher.h"
+#include "shm_frame_layout.h"
+
+namespace app {
+
+/**
+ * Publishes buffer textures into a POSIX shared-memory ring (see shm_frame_layout.h) for
+ * processes on the same machine, such as a projection mapper or a recorder, where Syphon is
+ * not available.
+ *
+ * A texture is read back asynchronously into a pixel buffer object and written into the ring
+ * at the next beginFrame(), so publishing never stalls the GL thread waiting on the GPU, and
+ * frames go out one frame late. Each frame is copied once, into the ring; consumers read it
+ * in place however many of them there are.
+ *
+ * Slots are sized for maxWidth x maxHeight RGBA; larger textures are dropped with a warning.
+ */
+class shm_frame_server : public frame_publisher {
+public:
+    static int constexpr slotCount = 3;
+
+    shm_frame_server(const std::string& name, int bufferCount, int maxWidth, int maxHeight)
+            : name(name), readbacks(bufferCount), slotBytes((uint64_t) maxWidth * maxHeight * 4) {
+        bytes = shm_frames::getTotalBytes(bufferCount, slotCount, slotBytes);
+        int const fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0) {
+            ofLogWarning("shm_frame_server") << "cannot open " << name << ": " << std::strerror(errno);
+            return;
+        }
+        if (ftruncate(fd, (off_t) bytes) != 0) {
+            ofLogWarning("shm_frame_server") << "cannot size " << name << " to " << bytes << " bytes: "
+                                             << std::strerror(errno);
+            close(fd);
+            shm_unlink(name.c_str());
+            return;
+        }
+        void* const mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            ofLogWarning("shm_frame_server") << "cannot map " << name << ": " << std::strerror(errno);
+            shm_unlink(name.c_str());
+            return;
+        }
+        base = mapped;
+
+        // Consumers check the magic last, so it is stored only once the rest is in place.
+        auto* header = (shm_frames::header*) base;
+        header->magic.store(0, std::memory_order_relaxed);
+        header->version = shm_frames::version;
+        header->bufferCount = (uint32_t) bufferCount;
+        header->slotCount = slotCount;
+        header->slotBytes = slotBytes;
+        header->slotStride = shm_frames::getSlotStride(slotBytes);
+        header->bufferStride = shm_frames::getBufferStride(slotCount, slotBytes);
+        for (int buffer = 0; buffer < bufferCount; buffer++) {
+            shm_frames::getBuffer(base, buffer)->published.store(0, std::memory_order_relaxed);
+            for (int slot = 0; slot < slotCount; slot++) {
+                auto* written = shm_frames::getSlot(base, buffer, slot);
+                written->sequence.store(0, std::memory_order_relaxed);
+                written->width = written->height = written->channels = 0;
+            }
+        }
+        header->magic.store(shm_frames::magic, std::memory_order_release);
+        ofLogNotice("shm_frame_server") << "publishing " << bufferCount << " buffers to " << name << " ("
+                                        << bytes / (1024 * 1024) << " MB)";
+    }
+
+    ~shm_frame_server() {
+        if (base != nullptr) {
+            munmap(base, bytes);
+            shm_unlink(name.c_str());
+        }
+    }
+
+    bool isOpen() const {
+        return base != nullptr;
+    }
+
+    // GL thread. Finishes the readbacks started last frame.
+    void beginFrame() override {
+        for (int buffer = 0; buffer < (int) readbacks.size(); buffer++) {
+            auto& state = readbacks[buffer];
+            if (!state.pending) {
+                continue;
+            }
+            const uint8_t* pixels = state.pbo.map<uint8_t>(GL_READ_ONLY);
+            if (pixels != nullptr) {
+                write(buffer, pixels, state.width, state.height, state.channels);
+            }
+            state.pbo.unmap();
+            state.pending = false;
+        }
+    }
+
+    void publishTexture(int buffer, ofTexture* texture) override {
+        if (base == nullptr || buffer < 0 || buffer >= (int) readbacks.size()) {
+            return;
+        }
+        auto& data = texture->getTextureData();
+        int const width = (int) texture->getWidth();
+        int const height = (int) texture->getHeight();
+        int const glFormat = ofGetGLFormatFromInternal(data.glInternalFormat);
+        int const channels = ofGetNumChannelsFromGLFormat(glFormat);
+        if (ofGetBytesPerChannelFromGLType(ofGetGLTypeFromInternal(data.glInternalFormat)) != 1) {
+            warnOnce(buffer, "only 8-bit textures can be published");
+            return;
+        }
+        uint64_t const frameBytes = (uint64_t) width * height * channels;
+        if (frameBytes > slotBytes) {
+            warnOnce(buffer, "texture is larger than the slots");
+            return;
+        }
+
+        auto& state = readbacks[buffer];
+        if (!state.pbo.isAllocated()) {
+            state.pbo.allocate(slotBytes, GL_STREAM_READ);
+        }
+        texture->copyTo(state.pbo);
+        state.pending = true;
+        state.width = width;
+        state.height = height;
+        state.channels = channels;
+    }
+
+    // Copies one frame into the buffer's next slot and wakes any waiting consumer.
+    void write(int buffer, const uint8_t* pixels, int width, int height, int channels) {
+        auto* region = shm_frames::getBuffer(base, buffer);
+        uint32_t const published = region->published.load(std::memory_order_relaxed);
+        auto* slot = shm_frames::getSlot(base, buffer, (int) ((published + 1) % slotCount));
+
+        uint32_t const sequence = slot->sequence.load(std::memory_order_relaxed);
+        slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot->width = (uint32_t) width;
+        slot->height = (uint32_t) height;
+        slot->channels = (uint32_t) channels;
+        slot->frame = published + 1;
+        slot->micros = ofGetElapsedTimeMicros();
+        std::memcpy(shm_frames::getPixels(slot), pixels, (size_t) width * height * channels);
+        slot->sequence.store(sequence + 2, std::memory_order_release);
+
+        region->published.store(published + 1, std::memory_order_release);
+        shm_frames::wake(region->published);
+    }
+
+private:
+    struct readback {
+        ofBufferObject pbo;
+        bool pending = false;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        bool warned = false;
+    };
+
+    void warnOnce(int buffer, const std::string& message) {
+        if (!readbacks[buffer].warned) {
+            ofLogWarning("shm_frame_server") << "buffer " << buffer << ": " << message;
+            readbacks[buffer].warned = true;
+        }
+    }
+
+    std::string name;
+    std::vector<readback> readbacks;
+    uint64_t slotBytes;
+    uint64_t bytes = 0;
+    void* base = nullptr;
+};
+
+}
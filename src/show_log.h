@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace app {
+
+/**
+ * A compact binary record of a performance, written as it is played so it can be replayed
+ * offline (see offline_renderer::replay) to reproduce or profile a show.
+ *
+ * The header holds the show's seed, the audio settings and the samples registered, in order.
+ * Every effect scheduled or cancelled and every sample selected is then one fixed 40-byte
+ * event: the beat, what happened, and the parameters it happened with. A stutter or rewind
+ * carries the seed and tempo it was made with (see effect_factory), and one an
+ * effect_generator asked for carries that generator's id, as does the sample selection that
+ * came with it, so a generator's effects replay without running it again. Every other event
+ * carries the clock's tempo, and a tempo event is logged whenever that tempo changes. An end
+ * event closes the show. Fields are in host byte order.
+ */
+class show_log {
+public:
+    enum type : uint8_t {
+        stutter,
+        rewind,
+        generator,
+        select,
+        end,
+        cancel,
+        tempo
+    };
+
+    struct event {
+        double beat;
+        float beatsPerMinute;
+        float recordLengthBeats;
+        float rewindLengthBeats;
+        float stutterLengthBeats;
+        int32_t index;
+        uint32_t seed;
+        uint32_t generator;
+        uint8_t what;
+        uint8_t reserved[3];
+    };
+
+    struct header {
+        uint32_t seed = 0;
+        int32_t sampleRate = 0;
+        int32_t bufferSize = 0;
+        std::vector<std::string> samples;
+    };
+
+    static_assert(sizeof(event) == 40, "events are written as is");
+
+    static const char* getName(uint8_t what) {
+        static const char* const names[] = {"stutter", "rewind", "generator", "select", "end", "cancel", "tempo"};
+        return what <= tempo ? names[what] : "unknown";
+    }
+
+    ~show_log() {
+        file.close();
+    }
+
+    bool open(const std::string& path, const header& written) {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        write32(magic);
+        write32(version);
+        write32(written.seed);
+        write32((uint32_t) written.sampleRate);
+        write32((uint32_t) written.bufferSize);
+        write32((uint32_t) written.samples.size());
+        for (auto& sample : written.samples) {
+            write32((uint32_t) sample.size());
+            file.write(sample.data(), sample.size());
+        }
+        return (bool) file;
+    }
+
+    bool isOpen() const {
+        return file.is_open();
+    }
+
+    // Buffered; nothing reaches the disk until the buffer fills or the log is closed.
+    void write(const event& happened) {
+        if (file.is_open()) {
+            file.write(reinterpret_cast<const char*>(&happened), sizeof(happened));
+        }
+    }
+
+    bool close(double endBeat) {
+        if (!file.is_open()) {
+            return false;
+        }
+        write(makeEvent(end, endBeat));
+        bool const ok = (bool) file;
+        file.close();
+        return ok;
+    }
+
+    static event makeEvent(type what, double beat, int index = -1) {
+        event made;
+        std::memset(&made, 0, sizeof(made));
+        made.beat = beat;
+        made.index = index;
+        made.what = what;
+        return made;
+    }
+
+    static bool read(const std::string& path, header& loaded, std::vector<event>& events) {
+        std::ifstream file(path, std::ios::binary);
+        uint32_t foundMagic, foundVersion, sampleCount;
+        if (!read32(file, foundMagic) || foundMagic != magic
+                || !read32(file, foundVersion) || foundVersion != version) {
+            return false;
+        }
+        uint32_t sampleRate, bufferSize;
+        if (!read32(file, loaded.seed) || !read32(file, sampleRate) || !read32(file, bufferSize)
+                || !read32(file, sampleCount)) {
+            return false;
+        }
+        loaded.sampleRate = (int32_t) sampleRate;
+        loaded.bufferSize = (int32_t) bufferSize;
+        loaded.samples.clear();
+        for (uint32_t i = 0; i < sampleCount; i++) {
+            uint32_t length;
+            if (!read32(file, length) || length > maxNameLength) {
+                return false;
+            }
+            std::string sample(length, '\0');
+            if (!file.read(&sample[0], length)) {
+                return false;
+            }
+            loaded.samples.push_back(sample);
+        }
+
+        events.clear();
+        event happened;
+        while (file.read(reinterpret_cast<char*>(&happened), sizeof(happened))) {
+            events.push_back(happened);
+        }
+        // A show that was never closed, because the app crashed, still replays up to there.
+        return true;
+    }
+
+private:
+    static uint32_t constexpr magic = 0x474c5453;
+    static uint32_t constexpr version = 3;
+    static uint32_t constexpr maxNameLength = 4096;
+
+    void write32(uint32_t value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static bool read32(std::ifstream& file, uint32_t& value) {
+        return (bool) file.read(reinterpret_cast<char*>(&value), sizeof(value));
+    }
+
+    std::ofstream file;
+};
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace app {
+
+/**
+ * The show's controls as the audio thread sees them. The GL thread publishes the property
+ * values once per frame, after the property bag has taken the encoders' latest turns, and
+ * the audio engine reads a consistent copy once per block, so every sample of a block works
+ * from the same settings. Neither side locks; the reader retries through a sequence counter
+ * while a publish is in progress.
+ */
+class show_parameters {
+public:
+    struct values {
+        float beatsPerMinute = 0;
+        float recordLengthBeats = 0;
+        float rewindLengthBeats = 0;
+        float stutterLengthBeats = 0;
+        float outputGain = 1;
+    };
+
+    // GL thread.
+    void publish(const values& next) {
+        uint32_t const sequence = this->sequence.load(std::memory_order_relaxed);
+        this->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        beatsPerMinute.store(next.beatsPerMinute, std::memory_order_relaxed);
+        recordLengthBeats.store(next.recordLengthBeats, std::memory_order_relaxed);
+        rewindLengthBeats.store(next.rewindLengthBeats, std::memory_order_relaxed);
+        stutterLengthBeats.store(next.stutterLengthBeats, std::memory_order_relaxed);
+        outputGain.store(next.outputGain, std::memory_order_relaxed);
+        this->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Any thread.
+    values read() const {
+        values copy;
+        uint32_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            copy.beatsPerMinute = beatsPerMinute.load(std::memory_order_relaxed);
+            copy.recordLengthBeats = recordLengthBeats.load(std::memory_order_relaxed);
+            copy.rewindLengthBeats = rewindLengthBeats.load(std::memory_order_relaxed);
+            copy.stutterLengthBeats = stutterLengthBeats.load(std::memory_order_relaxed);
+            copy.outputGain = outputGain.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) != 0 || before != after);
+        return copy;
+    }
+
+    // How many times the values have been published.
+    uint32_t getPublishedCount() const {
+        return sequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<float> beatsPerMinute{0};
+    std::atomic<float> recordLengthBeats{0};
+    std::atomic<float> rewindLengthBeats{0};
+    std::atomic<float> stutterLengthBeats{0};
+    std::atomic<float> outputGain{1};
+};
+
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ofMain.h"
+#include "clock_source.h"
+
+namespace app {
+
+/**
+ * A Link clock simulated in-process, so timing can be tested and benchmarked on a machine
+ * with no network and with the same result every run. The beat starts at 0 when the clock is
+ * made and follows a script, one directive per line:
+ *
+ *     bpm 120
+ *     seed 1
+ *     jitterMillis 2
+ *     at 32 tempo 174
+ *     at 64 jump 0.5
+ *
+ * At each `at` beat the tempo changes, or the beat jumps by the given number of beats, as
+ * when a Link peer realigns the phase. Every getBeat() is off by up to jitterMillis either
+ * way, drawn from the seeded generator, as a reading from a busy network session would be.
+ *
+ * By default the clock runs on the app's elapsed time. A benchmark can instead step time
+ * itself with setTime().
+ */
+class simulated_clock : public clock_source {
+public:
+    struct event {
+        double beat;
+        std::string type;
+        double value;
+    };
+
+    struct script {
+        double bpm = 120;
+        uint32_t seed = 1;
+        double jitterMillis = 0;
+        std::vector<event> events;
+
+        bool parse(const std::string& path);
+    };
+
+    explicit simulated_clock(const script& timeline, bool manualTime = false)
+            : timeline(timeline), random(timeline.seed), jitter(-1.0, 1.0), tempo(timeline.bpm),
+              manualTime(manualTime) {
+        anchorMicros = manualTime ? 0 : ofGetElapsedTimeMicros();
+    }
+
+    double getBeat() override {
+        advance(getNow());
+        double const jitterBeats = timeline.jitterMillis / 60000.0 * tempo;
+        return beat + jitter(random) * jitterBeats;
+    }
+
+    double getTempo() override {
+        advance(getNow());
+        return tempo;
+    }
+
+    void setTempo(double beatsPerMinute) override {
+        advance(getNow());
+        tempo = beatsPerMinute;
+    }
+
+    // Only with manual time. Time never goes backwards; an earlier time is ignored.
+    void setTime(uint64_t micros) {
+        now = std::max(now, micros);
+    }
+
+    // The beat at the current time, without jitter.
+    double getTrueBeat() {
+        advance(getNow());
+        return beat;
+    }
+
+    // How many script events have been reached.
+    size_t getEventsReached() const {
+        return next;
+    }
+
+private:
+    uint64_t getNow() const {
+        return manualTime ? now : ofGetElapsedTimeMicros();
+    }
+
+    void advance(uint64_t micros) {
+        if (micros <= anchorMicros || tempo <= 0) {
+            anchorMicros = std::max(anchorMicros, micros);
+            return;
+        }
+        while (next < timeline.events.size()) {
+            const event& due = timeline.events[next];
+            double const reached = beat + (double) (micros - anchorMicros) / 1000000.0 * tempo / 60.0;
+            if (due.beat > reached) {
+                break;
+            }
+            if (due.beat > beat) {
+                anchorMicros += (uint64_t) ((due.beat - beat) * 60.0 / tempo * 1000000.0);
+                beat = due.beat;
+            }
+            if (due.type == "tempo") {
+                tempo = due.value;
+            } else {
+                beat += due.value;
+            }
+            next++;
+            if (tempo <= 0) {
+                anchorMicros = micros;
+                return;
+            }
+        }
+        beat += (double) (micros - anchorMicros) / 1000000.0 * tempo / 60.0;
+        anchorMicros = micros;
+    }
+
+    const script& timeline;
+    std::mt19937 random;
+    std::uniform_real_distribution<double> jitter;
+    double tempo;
+    double beat = 0;
+    uint64_t anchorMicros;
+    size_t next = 0;
+    bool manualTime;
+    uint64_t now = 0;
+};
+
+inline bool simulated_clock::script::parse(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        ofLogError("simulated_clock") << "cannot read script " << path;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream words(line);
+        std::string directive;
+        if (!(words >> directive) || directive[0] == '#') {
+            continue;
+        }
+
+        bool ok = true;
+        if (directive == "bpm") {
+            ok = (bool) (words >> bpm) && bpm > 0;
+        } else if (directive == "seed") {
+            ok = (bool) (words >> seed);
+        } else if (directive == "jitterMillis") {
+            ok = (bool) (words >> jitterMillis) && jitterMillis >= 0;
+        } else if (directive == "at") {
+            event scheduled = {0, "", 0};
+            ok = (bool) (words >> scheduled.beat >> scheduled.type >> scheduled.value)
+                    && (scheduled.type == "jump" || (scheduled.type == "tempo" && scheduled.value > 0));
+            events.push_back(scheduled);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            ofLogError("simulated_clock") << path << ":" << lineNumber << ": cannot parse \"" << line << "\"";
+            return false;
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const event& a, const event& b) {
+        return a.beat < b.beat;
+    });
+    return true;
+}
+
+}
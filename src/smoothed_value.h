@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cmath>
+
+namespace app {
+
+/**
+ * A control value followed one sample at a time, so a parameter that only changes once per
+ * block, such as an encoder turn, sweeps instead of stepping and does not zipper.
+ *
+ * A linear ramp reaches each new target in exactly the smoothing time, starting over from
+ * wherever it is when the target moves. An exponential one closes a fixed share of the gap
+ * every sample, reaching about 63% of the way in the smoothing time, and snaps to the target
+ * once it is within a millionth of it, or once a step no longer moves it: in float, a gap
+ * smaller than about half an ulp over the coefficient never closes. A smoothing time of 0
+ * follows the target at once. A control only read once per block can be moved on a whole
+ * block at a time with advance().
+ * Audio thread only.
+ */
+class smoothed_value {
+public:
+    enum shape {
+        linear,
+        exponential
+    };
+
+    smoothed_value(shape curve, float smoothingMillis, int sampleRate, float initial = 0)
+            : curve(curve), value(initial), target(initial) {
+        float const samples = smoothingMillis / 1000.0f * sampleRate;
+        rampSamples = samples < 1 ? 0 : (int) samples;
+        coefficient = samples < 1 ? 1.0f : 1.0f - std::exp(-1.0f / samples);
+    }
+
+    void setTarget(float next) {
+        if (next == target) {
+            return;
+        }
+        target = next;
+        if (rampSamples == 0) {
+            value = target;
+            remaining = 0;
+        } else if (curve == linear) {
+            remaining = rampSamples;
+            step = (target - value) / rampSamples;
+        } else {
+            remaining = 1;
+        }
+    }
+
+    // Jumps straight to `next`, e.g. when playback restarts.
+    void reset(float next) {
+        value = target = next;
+        remaining = 0;
+    }
+
+    float next() {
+        if (remaining == 0) {
+            return value;
+        }
+        if (curve == linear) {
+            value = --remaining == 0 ? target : value + step;
+        } else {
+            settle(value + (target - value) * coefficient);
+        }
+        return value;
+    }
+
+    // Where `samples` calls to next() would leave the value, in one step.
+    float advance(int samples) {
+        if (remaining == 0 || samples <= 0) {
+            return value;
+        }
+        if (curve == linear) {
+            remaining = samples >= remaining ? 0 : remaining - samples;
+            value = remaining == 0 ? target : target - step * remaining;
+        } else {
+            settle(target + (value - target) * std::pow(1.0f - coefficient, (float) samples));
+        }
+        return value;
+    }
+
+    bool isSmoothing() const {
+        return remaining != 0;
+    }
+
+    float getValue() const {
+        return value;
+    }
+
+    float getTarget() const {
+        return target;
+    }
+
+private:
+    static float constexpr snapDistance = 1e-6f;
+
+    void settle(float moved) {
+        if (moved == value || std::fabs(target - moved) <= snapDistance) {
+            value = target;
+            remaining = 0;
+        } else {
+            value = moved;
+        }
+    }
+
+    shape curve;
+    int rampSamples;
+    float coefficient;
+    float value;
+    float target;
+    float step = 0;
+    int remaining = 0;
+};
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace app {
+
+/**
+ * Bounded single-producer/single-consumer ring. push() and pop() are wait-free and never
+ * allocate, so the consumer side is safe to call from the audio callback. Exactly one thread
+ * may push and exactly one thread may pop.
+ */
+template<typename T, size_t Capacity>
+class spsc_queue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool push(const T& item) {
+        size_t const tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        items[tail & (Capacity - 1)] = item;
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t const head = this->head.load(std::memory_order_relaxed);
+        if (head == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[head & (Capacity - 1)];
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    // Padded rather than alignas() so the queue can live inside heap objects under C++11.
+    static size_t constexpr cacheLine = 64;
+    std::atomic<size_t> head{0};
+    char headPadding[cacheLine - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail{0};
+    char tailPadding[cacheLine - sizeof(std::atomic<size_t>)];
+    std::array<T, Capacity> items;
+};
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include "ofMain.h"
+
+namespace app {
+
+/**
+ * Holds the last few drawn frames, each tagged with the beat it was drawn for, so the picture
+ * can be shown when its beat is heard rather than when it was drawn. Frames are drawn into
+ * a ring of FBOs allocated up front.
+ *
+ * Only the composited window goes through the ring. The buffers published over Syphon or
+ * shared memory go out as soon as they are drawn, a full output latency ahead of the sound,
+ * so a consumer that wants them in step has to hold them back by that much itself.
+ */
+class video_delay {
+public:
+    video_delay(int width, int height, int capacity) : frames(capacity > 0 ? capacity : 1) {
+        for (auto& each : frames) {
+            each.fbo.allocate(width, height, GL_RGBA);
+        }
+    }
+
+    void begin() {
+        frames[next].fbo.begin();
+        ofClear(0, 255);
+    }
+
+    void end(double beat) {
+        frames[next].fbo.end();
+        frames[next].beat = beat;
+        next = (next + 1) % (int) frames.size();
+        if (count < (int) frames.size()) {
+            count++;
+        }
+    }
+
+    // Draws the newest frame drawn for `beat` or earlier, or the oldest held if every frame is
+    // later, and returns the beat of the frame drawn.
+    double draw(double beat, float x, float y, float width, float height) const {
+        if (count == 0) {
+            return beat;
+        }
+        int shown = -1;
+        for (int ago = 0; ago < count; ago++) {
+            shown = (next - 1 - ago + (int) frames.size()) % (int) frames.size();
+            if (frames[shown].beat <= beat) {
+                break;
+            }
+        }
+        frames[shown].fbo.draw(x, y, width, height);
+        return frames[shown].beat;
+    }
+
+private:
+    struct frame {
+        ofFbo fbo;
+        double beat = 0;
+    };
+
+    std::vector<frame> frames;
+    int next = 0;
+    int count = 0;
+};
+
+}
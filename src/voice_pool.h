@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "ofxBenG.h"
+
+namespace app {
+
+/**
+ * The effects that are currently playing, capped at a fixed polyphony. All slots are
+ * allocated up front, so starting, finishing and stealing voices on the audio thread never
+ * allocates. When every slot is busy the oldest voice is stolen to make room.
+ *
+ * Effects that make no sound of their own and run until cancelled, such as an
+ * effect_generator, are started as background voices. These have slots of their own: they
+ * do not count against the polyphony and are never stolen, or a generator, always the
+ * oldest voice, would be the first to go. If every background slot is busy the new one is
+ * retired at once and counted in getRefusedCount().
+ *
+ * The pool never deletes an effect itself; finished, stolen and stopped effects are handed
+ * back through the `retire` callback so they can be freed off the audio thread. Finished
+ * voices are compacted by moving the last one down, so each costs O(1) to remove.
+ */
+class voice_pool {
+public:
+    explicit voice_pool(int capacity, int backgroundCapacity = 16)
+            : voices(capacity), background(backgroundCapacity) {}
+
+    int getCapacity() const {
+        return (int) voices.size();
+    }
+
+    int getActiveCount() const {
+        return activeCount.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getStolenCount() const {
+        return stolenCount.load(std::memory_order_relaxed);
+    }
+
+    int getBackgroundCount() const {
+        return backgroundActive.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getRefusedCount() const {
+        return refusedCount.load(std::memory_order_relaxed);
+    }
+
+    // Audio thread.
+    template<typename Retire>
+    void start(ofxBenG::beat_action* effect, uint64_t handle, double beat, Retire retire, bool inBackground = false) {
+        if (inBackground) {
+            if (backgroundCount == (int) background.size()) {
+                retire(effect);
+                refusedCount.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            background[backgroundCount++] = {effect, handle, nextSerial++};
+            effect->update((float) beat);
+            backgroundActive.store(backgroundCount, std::memory_order_relaxed);
+            return;
+        }
+        if (count == getCapacity()) {
+            int const oldest = findOldest();
+            retire(voices[oldest].effect);
+            remove(oldest);
+            stolenCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        voices[count++] = {effect, handle, nextSerial++};
+        effect->update((float) beat);
+        activeCount.store(count, std::memory_order_relaxed);
+    }
+
+    // Audio thread.
+    template<typename Retire>
+    void update(double beat, Retire retire) {
+        update(background, backgroundCount, beat, retire);
+        update(voices, count, beat, retire);
+        backgroundActive.store(backgroundCount, std::memory_order_relaxed);
+        activeCount.store(count, std::memory_order_relaxed);
+    }
+
+    // Audio thread. Stops the voice playing the effect with this handle, if there is one.
+    template<typename Retire>
+    bool stop(uint64_t handle, Retire retire) {
+        bool const stopped = stop(voices, count, handle, retire) || stop(background, backgroundCount, handle, retire);
+        backgroundActive.store(backgroundCount, std::memory_order_relaxed);
+        activeCount.store(count, std::memory_order_relaxed);
+        return stopped;
+    }
+
+    // Hands every voice back, e.g. on shutdown once the audio thread has stopped.
+    template<typename Retire>
+    void clear(Retire retire) {
+        for (int i = 0; i < count; i++) {
+            retire(voices[i].effect);
+        }
+        for (int i = 0; i < backgroundCount; i++) {
+            retire(background[i].effect);
+        }
+        count = 0;
+        backgroundCount = 0;
+        activeCount.store(0, std::memory_order_relaxed);
+        backgroundActive.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct voice {
+        ofxBenG::beat_action* effect;
+        uint64_t handle;
+        uint64_t serial;
+    };
+
+    int findOldest() const {
+        int oldest = 0;
+        for (int i = 1; i < count; i++) {
+            if (voices[i].serial < voices[oldest].serial) {
+                oldest = i;
+            }
+        }
+        return oldest;
+    }
+
+    template<typename Retire>
+    static void update(std::vector<voice>& playing, int& playingCount, double beat, Retire retire) {
+        for (int i = 0; i < playingCount;) {
+            ofxBenG::beat_action* const effect = playing[i].effect;
+            effect->update((float) beat);
+            if (effect->isDone((float) beat)) {
+                retire(effect);
+                playing[i] = playing[--playingCount];
+            } else {
+                i++;
+            }
+        }
+    }
+
+    template<typename Retire>
+    static bool stop(std::vector<voice>& playing, int& playingCount, uint64_t handle, Retire retire) {
+        for (int i = 0; i < playingCount; i++) {
+            if (playing[i].handle == handle) {
+                retire(playing[i].effect);
+                playing[i] = playing[--playingCount];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Age is tracked by serial, so slots can be compacted by moving the last one down.
+    void remove(int index) {
+        voices[index] = voices[--count];
+    }
+
+    std::vector<voice> voices;
+    std::vector<voice> background;
+    int count = 0;
+    int backgroundCount = 0;
+    uint64_t nextSerial = 0;
+    std::atomic<int> activeCount{0};
+    std::atomic<int> backgroundActive{0};
+    std::atomic<uint64_t> stolenCount{0};
+    std::atomic<uint64_t> refusedCount{0};
+};
+
+}
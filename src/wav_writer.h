@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace app {
+
+/**
+ * Streams interleaved 32-bit float frames to a WAV file. The RIFF sizes are patched in by
+ * close(), so the frame count does not need to be known up front.
+ */
+class wav_writer {
+public:
+    bool open(const std::string& path, int sampleRate, int nChannels) {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        this->nChannels = nChannels;
+        dataBytes = 0;
+
+        uint16_t const floatFormat = 3;
+        uint16_t const bitsPerSample = 32;
+        uint16_t const blockAlign = (uint16_t) (nChannels * bitsPerSample / 8);
+        uint32_t const byteRate = (uint32_t) sampleRate * blockAlign;
+
+        file.write("RIFF", 4);
+        write32(0);
+        file.write("WAVE", 4);
+        file.write("fmt ", 4);
+        write32(16);
+        write16(floatFormat);
+        write16((uint16_t) nChannels);
+        write32((uint32_t) sampleRate);
+        write32(byteRate);
+        write16(blockAlign);
+        write16(bitsPerSample);
+        file.write("data", 4);
+        write32(0);
+        return (bool) file;
+    }
+
+    void write(const float* interleaved, int frames) {
+        size_t const bytes = (size_t) frames * nChannels * sizeof(float);
+        file.write(reinterpret_cast<const char*>(interleaved), bytes);
+        dataBytes += bytes;
+    }
+
+    bool close() {
+        file.seekp(4);
+        write32((uint32_t) (36 + dataBytes));
+        file.seekp(40);
+        write32((uint32_t) dataBytes);
+        bool const ok = (bool) file;
+        file.close();
+        return ok;
+    }
+
+private:
+    void write16(uint16_t value) {
+        char const bytes[2] = {(char) (value & 0xff), (char) (value >> 8)};
+        file.write(bytes, 2);
+    }
+
+    void write32(uint32_t value) {
+        char const bytes[4] = {(char) (value & 0xff), (char) ((value >> 8) & 0xff),
+                               (char) ((value >> 16) & 0xff), (char) (value >> 24)};
+        file.write(bytes, 4);
+    }
+
+    std::ofstream file;
+    int nChannels = 2;
+    size_t dataBytes = 0;
+};
+
+}
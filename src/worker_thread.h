@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace app {
+
+/**
+ * Runs slow jobs, such as sample decoding, on a worker thread so that neither the GL thread
+ * nor the audio thread ever waits on disk or on a large copy. Jobs run in the order they were
+ * posted.
+ */
+class worker_thread {
+public:
+    worker_thread() : worker(&worker_thread::run, this) {}
+
+    ~worker_thread() {
+        stop();
+    }
+
+    // Lets the running job finish, drops the rest and joins the worker.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    void post(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+        wake.notify_one();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) {
+                return;
+            }
+
+            std::function<void()> const next = jobs.front();
+            jobs.pop_front();
+            lock.unlock();
+            next();
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> jobs;
+    bool stopping = false;
+    std::thread worker;
+};
+
+}
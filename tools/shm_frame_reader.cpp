@@ -0,0 +1,147 @@
+// Reference consumer for the frames Stutter publishes to shared memory on Linux. It reads
+// frames in place, straight out of the mapping, and reports the frame rate and torn reads
+// per second; with --ppm it also saves the first complete frame.
+//
+//     c++ -std=c++11 -O2 -Isrc tools/shm_frame_reader.cpp -o shm_frame_reader -lrt
+//     ./shm_frame_reader [--name /stutter-frames] [--buffer 0] [--ppm frame.ppm]
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shm_frame_layout.h"
+
+using namespace app;
+
+static bool savePpm(const std::string& path, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::fprintf(file, "P6\n%u %u\n255\n", width, height);
+    for (size_t i = 0; i < (size_t) width * height; i++) {
+        std::fwrite(pixels + i * channels, 1, channels < 3 ? channels : 3, file);
+    }
+    return std::fclose(file) == 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string name = "/stutter-frames";
+    int buffer = 0;
+    std::string ppmPath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string const flag = argv[i];
+        if (flag == "--name") {
+            name = argv[i + 1];
+        } else if (flag == "--buffer") {
+            buffer = std::atoi(argv[i + 1]);
+        } else if (flag == "--ppm") {
+            ppmPath = argv[i + 1];
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // The server creates the object, sizes it and only then writes the magic, so until both
+    // show up the ring is still being set up rather than not a frame ring.
+    void* base = nullptr;
+    shm_frames::header* header = nullptr;
+    while (true) {
+        int const fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd >= 0) {
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size >= (off_t) sizeof(shm_frames::header)) {
+                base = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (base == MAP_FAILED) {
+                    std::perror("mmap");
+                    close(fd);
+                    return 1;
+                }
+                header = (shm_frames::header*) base;
+                if (header->magic.load(std::memory_order_acquire) == shm_frames::magic) {
+                    close(fd);
+                    break;
+                }
+                munmap(base, (size_t) info.st_size);
+            }
+            close(fd);
+        }
+        std::fprintf(stderr, "waiting for %s\n", name.c_str());
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    if (header->version != shm_frames::version) {
+        std::fprintf(stderr, "%s is not a version %u frame ring\n", name.c_str(), shm_frames::version);
+        return 1;
+    }
+    if (buffer < 0 || buffer >= (int) header->bufferCount) {
+        std::fprintf(stderr, "buffer %d out of range, %s has %u\n", buffer, name.c_str(), header->bufferCount);
+        return 1;
+    }
+
+    auto* region = shm_frames::getBuffer(base, buffer);
+    uint32_t seen = region->published.load(std::memory_order_acquire);
+    int frames = 0;
+    int torn = 0;
+    uint64_t checksum = 0;
+    std::vector<uint8_t> snapshot;
+    auto reported = std::chrono::steady_clock::now();
+    while (true) {
+        shm_frames::wait(region->published, seen, 100);
+        uint32_t const published = region->published.load(std::memory_order_acquire);
+        if (published != seen) {
+            seen = published;
+            auto* slot = shm_frames::getSlot(base, buffer, (int) (published % header->slotCount));
+            uint32_t const before = slot->sequence.load(std::memory_order_acquire);
+            uint32_t const width = slot->width;
+            uint32_t const height = slot->height;
+            uint32_t const channels = slot->channels;
+            const uint8_t* pixels = shm_frames::getPixels(slot);
+
+            // Stand-in for real work on the frame: touch one byte per row.
+            uint64_t sum = 0;
+            for (uint32_t row = 0; row < height; row++) {
+                sum += pixels[(size_t) row * width * channels];
+            }
+            // Saving is too slow to do in place, so that one frame is copied out first.
+            if (!ppmPath.empty() && (before & 1) == 0) {
+                snapshot.assign(pixels, pixels + (size_t) width * height * channels);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((before & 1) != 0 || slot->sequence.load(std::memory_order_relaxed) != before) {
+                torn++;
+            } else {
+                frames++;
+                checksum += sum;
+                if (!snapshot.empty()) {
+                    if (savePpm(ppmPath, snapshot.data(), width, height, channels)) {
+                        std::printf("saved %ux%u frame %u to %s\n", width, height, published, ppmPath.c_str());
+                    } else {
+                        std::perror(ppmPath.c_str());
+                    }
+                    ppmPath.clear();
+                }
+            }
+            snapshot.clear();
+        }
+
+        auto const now = std::chrono::steady_clock::now();
+        if (now - reported >= std::chrono::seconds(1)) {
+            std::printf("buffer %d: %d fps, %d torn, checksum %llu\n", buffer, frames, torn,
+                    (unsigned long long) checksum);
+            std::fflush(stdout);
+            frames = 0;
+            torn = 0;
+            reported = now;
+        }
+    }
+}
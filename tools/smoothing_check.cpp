@@ -0,0 +1,113 @@
+// Checks that app::smoothed_value settles on its target in both shapes: that a linear ramp
+// lands exactly on it after the smoothing time, that an exponential one moves steadily
+// toward it and stops smoothing within a bounded number of samples rather than stalling a
+// few ulps short, and that advancing a block at a time follows the same sweep. Exits
+// non-zero if any check fails.
+//
+//     c++ -std=c++11 -O2 -Isrc tools/smoothing_check.cpp -o smoothing_check
+//     ./smoothing_check
+
+#include <cmath>
+#include <cstdio>
+#include "smoothed_value.h"
+
+using namespace app;
+
+static int failures = 0;
+
+static void check(bool passed, const char* name, float from, float to, long samples) {
+    std::printf("%s %s %g -> %g after %ld samples\n", passed ? "ok  " : "FAIL", name, from, to, samples);
+    if (!passed) {
+        failures++;
+    }
+}
+
+static void checkLinear(float from, float to, float smoothingMillis, int sampleRate) {
+    smoothed_value smoothed(smoothed_value::linear, smoothingMillis, sampleRate, from);
+    smoothed.setTarget(to);
+    long const rampSamples = (long) (smoothingMillis / 1000.0f * sampleRate);
+    long samples = 0;
+    while (smoothed.isSmoothing() && samples <= rampSamples) {
+        smoothed.next();
+        samples++;
+    }
+    check(!smoothed.isSmoothing() && samples == rampSamples && smoothed.getValue() == to,
+          "linear", from, to, samples);
+}
+
+// Forty time constants leave a gap of e^-40 of the jump, far below float precision, so a
+// value still smoothing by then has stalled.
+static void checkExponential(float from, float to, float smoothingMillis, int sampleRate) {
+    smoothed_value smoothed(smoothed_value::exponential, smoothingMillis, sampleRate, from);
+    smoothed.setTarget(to);
+    long const limit = (long) (40 * smoothingMillis / 1000.0f * sampleRate);
+    float const direction = to > from ? 1.0f : -1.0f;
+    float last = from;
+    bool steady = true;
+    long samples = 0;
+    while (smoothed.isSmoothing() && samples <= limit) {
+        float const value = smoothed.next();
+        steady = steady && (value - last) * direction >= 0 && (to - value) * direction >= 0;
+        last = value;
+        samples++;
+    }
+    check(steady && !smoothed.isSmoothing() && smoothed.getValue() == to, "exponential", from, to, samples);
+}
+
+// Moving on a block at a time must track a per-sample sweep and settle on the same target.
+static void checkAdvance(smoothed_value::shape curve, const char* name, float from, float to, int blockSize) {
+    smoothed_value perSample(curve, 20, 44100, from);
+    smoothed_value perBlock(curve, 20, 44100, from);
+    perSample.setTarget(to);
+    perBlock.setTarget(to);
+    float const tolerance = 1e-4f * std::fabs(to - from);
+    bool tracking = true;
+    long samples = 0;
+    while (perBlock.isSmoothing() && samples < 44100L * 10) {
+        for (int i = 0; i < blockSize; i++) {
+            perSample.next();
+        }
+        perBlock.advance(blockSize);
+        samples += blockSize;
+        tracking = tracking && std::fabs(perSample.getValue() - perBlock.getValue()) <= tolerance;
+    }
+    check(tracking && !perBlock.isSmoothing() && perBlock.getValue() == to, name, from, to, samples);
+}
+
+int main() {
+    int const sampleRate = 44100;
+    float const smoothingMillis = 20;
+
+    checkLinear(0, 1, smoothingMillis, sampleRate);
+    checkLinear(1, 0.25f, smoothingMillis, sampleRate);
+
+    checkExponential(0, 1, smoothingMillis, sampleRate);
+    checkExponential(1, 0, smoothingMillis, sampleRate);
+    checkExponential(0.5f, 0.75f, smoothingMillis, sampleRate);
+    checkExponential(120, 174, smoothingMillis, sampleRate);
+    checkExponential(0.25f, 8, smoothingMillis, sampleRate);
+    checkExponential(0, 1, 1000, sampleRate);
+    checkExponential(0, 1, 5, 192000);
+
+    // A target moved mid-sweep must still be reached.
+    smoothed_value moved(smoothed_value::exponential, smoothingMillis, sampleRate, 0);
+    moved.setTarget(1);
+    for (int i = 0; i < 100; i++) {
+        moved.next();
+    }
+    float const from = moved.getValue();
+    moved.setTarget(0.5f);
+    long samples = 0;
+    while (moved.isSmoothing() && samples < 40L * sampleRate) {
+        moved.next();
+        samples++;
+    }
+    check(!moved.isSmoothing() && moved.getValue() == 0.5f, "retarget", from, 0.5f, samples);
+
+    checkAdvance(smoothed_value::linear, "linear blocks", 120, 174, 512);
+    checkAdvance(smoothed_value::exponential, "exponential blocks", 120, 174, 512);
+    checkAdvance(smoothed_value::exponential, "exponential blocks", 8, 0.25f, 64);
+
+    std::printf("%d failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}